@@ -7,16 +7,20 @@
 # define GRID_ERR 4
 # define NO_ARG_ERR 5
 # define BAD_FILE_ERR 6
+# define THREAD_ERR 7
+# define WRITE_FILE_ERR 8
 
 # define MALLOC_FAIL "\nERROR: Could not allocate memory\n"
 # define OPEN_FILE "\nERROR: Could not open the file\n"
+# define WRITE_FILE "\nERROR: Could not write the file\n"
 # define GRID "\nERROR: Invalid step size\n min: 0.00001 | max: 0.5\n"
 # define SMALL_S_SIZE "\nWARNING: Small step size —-- model display may lag considerably\nEnter 0 to proceed    |     1 to enter new value       |        2 to exit: "
 # define ASK_SIZE "Please enter step size: "
 # define ASK_ITER "Please enter number of iterations: "
+# define THREAD "\nERROR: Could not start worker thread\n"
 
 # define ARGS "\nERROR: Invalid program arguments\n"
-# define USAGE "\nUSAGE: \n./morphosis *step_size* *q.x* *q.y* *q.z* *q.w*\n./morphosis -d\t\t\t\t\t\t| to use default values\n./morphosis -m *file_name.mat*\t\t\t\t| to read data from matrix\n./morphosis -p *file_name*\t\t\t\t| to read data from poem\n\n"
+# define USAGE "\nUSAGE: \n./morphosis *step_size* *q.x* *q.y* *q.z* *q.w*\n./morphosis -d\t\t\t\t\t\t| to use default values\n./morphosis -m *file_name.mat*\t\t\t\t| to read data from matrix\n./morphosis -p *file_name*\t\t\t\t| to read data from poem\n\nOPTIONS:\n-j *N*\t\t\t\t\t\t| build with N worker threads (0: one per core)\n--field binary|distance\t\t\t\t| inside/outside samples or signed distance estimate\n--mesher cubes|nets\t\t\t\t| marching cubes, or surface nets: one vertex per surface cell\n--octree\t\t\t\t\t| skip bricks proven inside or outside\n--symmetry\t\t\t\t\t| sample half the lattice or less when the set is symmetric\n--stream-out *file_name.obj*\t\t\t| write the mesh while it is built, without the viewer\n--periodicity\t\t\t\t\t| stop iterating orbits that come back on themselves\n--validate-periodicity\t\t\t\t| same, and check every early stop against the full run\n--orbits *file_name*\t\t\t\t| keep bounded orbits, so a rerun with more iterations continues them\n--refine *N*\t\t\t\t\t| build N levels, halving the step down to step_size and keeping the points sampled\n--headless\t\t\t\t\t| build and export without the viewer\n-o *file_name*\t\t\t\t\t| export to this file, as .obj, .ply, .stl or .glb (default ./fractal.obj)\n--format obj|ply|stl|glb\t\t\t| export format, instead of the one of the extension\n--weld *eps*\t\t\t\t\t| merge OBJ export vertices closer than eps\n--iter *N*\t\t\t\t\t| iterations, instead of asking for them\n\n"
 # define NO_ARG "\nThis program calculates, displays and saves a 4d Julia set as an OBJ file in the current directory\nWhen fractal is displayed, press ESC to exit or S to save and export the mesh\n"
 
 # define BAD_FILE "\nERROR: Invalid data in the file\n\n"
@@ -6,17 +6,31 @@
 # define VERTEX_SRC "./shaders/vertex.shader"
 # define FRAGMENT_SRC "./shaders/fragment.shader"
 
-# define GLEW_STATIC
-# include <GL/glew.h>
-# include <GLFW/glfw3.h>
+# ifndef CONF_NO_GL
+#  define GLEW_STATIC
+#  include <GL/glew.h>
+#  include <GLFW/glfw3.h>
+#  include <cglm/cglm.h>
+# else
+
+/*
+** Headless build: no GL header is needed, only the types t_gl and
+** t_matrix carry. None of the gl_*.c files are compiled.
+*/
+
+typedef unsigned int		GLuint;
+typedef struct GLFWwindow	GLFWwindow;
+typedef float				vec3[3];
+typedef float				mat4[4][4];
+# endif
 # include "stb_image.h"
-# include <cglm/cglm.h>
 
 # include <structures.h>
 
 # define SRC_WIDTH 800
 # define SRC_HEIGHT 600
 
+# ifndef CONF_NO_GL
 
 void 						init_gl(t_gl *gl);
 t_matrix 					*initGlMatrices(void);
@@ -29,6 +43,7 @@ void 						processInput(GLFWwindow *window, t_gl *gl);
 void 						terminate_gl(t_gl *gl);
 
 void 						createVBO(t_gl *gl, GLsizeiptr size, GLfloat *points);
+void 						createEBO(t_gl *gl, GLsizeiptr size, GLuint *indices);
 void						createVAO(t_gl *gl);
 
 void 						makeShaderProgram(t_gl *gl);
@@ -58,5 +73,6 @@ void						update_camera_rotation(t_gl *gl);
 
 // Text rendering
 void						render_button_text(t_gl *gl, t_ui_button *button);
+# endif
 
 #endif
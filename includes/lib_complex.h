@@ -1,7 +1,11 @@
 #ifndef _LIB_COMPLEX_H
 # define _LIB_COMPLEX_H
 
-# include <OpenCL/opencl.h>
+# ifdef __APPLE__
+#  include <OpenCL/opencl.h>
+# else
+#  include <CL/cl.h>
+# endif
 # include "opencl-c-base.h"
 #include "math.h"
 
@@ -25,6 +29,25 @@
  typedef float			TYPE;
 # endif
 
+/*
+** Closed interval [lo, hi], and a quaternion with an interval for each
+** component: every quaternion of an axis-aligned box of them at once.
+*/
+
+typedef struct	s_interval
+{
+	TYPE		lo;
+	TYPE		hi;
+}				cl_interval;
+
+typedef struct	s_iquat
+{
+	cl_interval	x;
+	cl_interval	y;
+	cl_interval	z;
+	cl_interval	w;
+}				cl_iquat;
+
 # define I_cl ((cl_complex)(0.0, 1.0))
 # define Pi_cl 3.14159265358979323846
 # define E_cl 2.718281828459045235360
@@ -42,9 +65,22 @@ cl_complex 		cl_cexp(cl_complex n);
 cl_complex 		cl_clog(cl_complex z);
 TYPE			cl_cdot(cl_complex a, cl_complex b);
 cl_quat			cl_quat_mult(cl_quat q1, cl_quat q2);
+cl_quat			cl_quat_sqr(cl_quat q);
+cl_quat			cl_quat_sqr_add(cl_quat q, cl_quat c, TYPE *mod_squared);
 cl_quat 		cl_quat_sum(cl_quat q1, cl_quat q2);
 cl_quat 		cl_quat_conjugate(cl_quat q);
 TYPE 			cl_quat_mod(cl_quat q);
 TYPE 			cl_quat_mod_squared(cl_quat q);
+int 			cl_quat_equal(cl_quat q1, cl_quat q2);
+cl_interval		cl_interval_make(TYPE a, TYPE b);
+cl_interval		cl_interval_sum(cl_interval a, cl_interval b);
+cl_interval		cl_interval_sub(cl_interval a, cl_interval b);
+cl_interval		cl_interval_mult(cl_interval a, cl_interval b);
+cl_interval		cl_interval_sqr(cl_interval a);
+cl_iquat		cl_iquat_make(cl_quat lo, cl_quat hi);
+cl_iquat		cl_iquat_mult(cl_iquat q1, cl_iquat q2);
+cl_iquat		cl_iquat_sum(cl_iquat q1, cl_iquat q2);
+cl_iquat		cl_iquat_sqr_add(cl_iquat q, cl_quat c, cl_interval *mod_squared);
+cl_interval		cl_iquat_mod_squared(cl_iquat q);
 
 #endif
@@ -14,37 +14,144 @@
 # define OUTPUT_FILE "./fractal.obj"
 # define OUTPUT_PRECISION 3
 
+# define FORMAT_AUTO 0
+# define FORMAT_OBJ 1
+# define FORMAT_PLY 2
+# define FORMAT_STL 3
+# define FORMAT_GLB 4
+# define WRITE_CHUNK (1 << 20)
+
+# define VCACHE_SIZE 32
+# define VCACHE_CHUNK (1 << 16)
+
+# define FIELD_BINARY 0
+# define FIELD_DISTANCE 1
+
+# define MESHER_CUBES 0
+# define MESHER_NETS 1
+
+# define PERIODICITY_OFF 0
+# define PERIODICITY_ON 1
+# define PERIODICITY_VALIDATE 2
+
+# define BRICK_SIZE 8
+# define BLOCK_UNKNOWN 0
+# define BLOCK_OUTSIDE 1
+# define BLOCK_INSIDE 2
+
+# define ORBIT_MAGIC "MORPHORB"
+# define ORBIT_SETTLED 0
+# define ORBIT_ESCAPED 1
+# define ORBIT_COLD 2
+# define ORBIT_WARM 3
+# define ORBIT_KINDS 4
+
+# define MIRROR_X 1
+# define MIRROR_Y 2
+# define MIRROR_Z 4
+
+# define EDGE_NONE 0xffffffffu
+
+# define SLAB_MIN_DEPTH 8
+# define SLAB_TARGET_COUNT 64
+# define ROW_TASKS 4
+
 t_data						*init_data(void);
 t_gl						*init_gl_struct(void);
 t_julia 					*init_julia(void);
 t_fract						*init_fract(void);
 void						init_grid(t_data *data);
-void						init_vertex(t_data *data);
+
+void						init_opts(t_opts *opts);
+int							parse_options(int argv, char **argc, t_opts *opts);
 
 void 						error(int errno, t_data *data);
 float						s_size_warning(float size);
 
-float3						**arr_float3_cat(float3 **f_from, float3 **f_to, uint2 *len);
-float3 						**alloc_float3_arr(float3 **mem, uint2 *len);
+void						init_mesh(t_mesh *mesh);
+float3						*mesh_reserve_v(t_mesh *mesh, size_t count);
+uint						*mesh_reserve_idx(t_mesh *mesh, size_t count);
+void						clean_mesh(t_mesh *mesh);
+void						clean_symmetry(t_symmetry *s);
+void						clean_orbits(t_orbits *o);
+void						clean_level(t_level *l);
+void						clean_pool(t_pool *p);
+void						clean_tipsify(t_tipsify *t);
+double						wall_time(void);
 
 void 						clean_up(t_data *data);
 void						clean_gl(t_gl *gl);
 void 						clean_fract(t_fract *fract);
-void						clean_trigs(float3 **trigs, uint len);
 void 						clean_calcs(t_data *data);
 
 void 						calculate_point_cloud(t_data *data);
 void						create_grid(t_data *data);
-void 						subdiv_grid(float start, float stop, float step, float *axis);
-void						define_voxel(t_fract *fract, float s);
+void 						subdiv_grid(float mid, float step, size_t n, float *axis);
+void						define_voxel(t_fract *fract);
+
+void						build_fractal(t_data *data, t_level *coarse, t_level *keep);
+
+void						init_pool(t_pool *p, uint workers);
+void						pool_wake(t_pool *p);
+void						pool_run(t_pool *p, uint me, t_task task);
+void						pool_wait(t_pool *p, uint me, size_t *counter, size_t value);
 
-void						build_fractal(t_data *data);
+void						init_level(t_level *l, t_fract *f, size_t n, size_t words);
+int							level_fits(t_level *coarse, t_fract *f, size_t n);
+void						keep_plane(t_level *l, size_t z, const float *vals,
+								const uint64_t *bits);
+float						level_value(t_level *l, size_t x, size_t y, size_t z);
+void						level_path(char *buf, size_t size, const char *path, float step);
 
+int							classify_block(t_fract *f, size_t *lo, size_t *hi);
+void						build_octree(t_octree *o, t_fract *f, size_t n);
+unsigned char				brick_state(t_octree *o, size_t x, size_t y, size_t z);
+void						lattice_row_state(t_octree *o, size_t y, size_t z,
+								unsigned char *state, unsigned char *col);
+
+void						init_symmetry(t_symmetry *s, t_fract *f, size_t n, size_t words);
+void						store_plane(t_symmetry *s, pthread_mutex_t *lock, size_t z,
+								const float *vals, const uint64_t *bits, size_t n, size_t words);
+void						wait_plane(t_symmetry *s, pthread_mutex_t *lock, size_t z);
+
+t_orbits					*load_orbits(const char *path, t_fract *f, size_t n, size_t words);
+FILE						*open_orbits(const char *path, t_fract *f, size_t n);
+void						close_orbits(FILE *out, const char *path);
+void						write_record(FILE *out, t_record *rec, size_t n, size_t words);
+void						sample_row_orbits(t_build *b, t_worker *w, size_t y, size_t z,
+								size_t span, float *row, uint64_t *rec);
+
+uint						julia_escape_time(t_julia *julia, float3 pos);
+uint						julia_escape_path(t_julia *julia, float3 pos, unsigned char *path);
+float						julia_distance(t_julia *julia, float3 pos);
 float 						sample_4D_Julia(t_julia *julia, float3 pos);
+void						sample_4D_Julia_batch(t_julia *julia, const float *x, const float *y,
+								const float *z, size_t count, float *out, unsigned char *paths);
+void						julia_orbit_batch(t_julia *julia, float **q, size_t count, uint iters,
+								float *out);
 
-float3 						**polygonise(float3 *v_pos, float *v_val, uint2 *pos, t_data *data);
+size_t						occupancy_words(size_t n);
+void						pack_row(const float *vals, size_t count, uint64_t *row, size_t words);
+void						reverse_row(const uint64_t *src, uint64_t *dst, size_t n, size_t words);
+void						occupancy_window(uint64_t **rows, size_t k, size_t n, t_window *win);
+uint						window_case(t_window *win, uint j);
+void						define_cases(t_fract *fract);
+uint 						polygonise(t_cell *cell, t_case *cs, t_edge *edges, t_mesh *out);
+uint						net_vertex(t_cell *cell, t_case *cs, t_edge *edges, t_mesh *out);
 
 void 						export_obj(t_data *data);
+int							format_of(const char *name);
+void						export_mesh(t_data *data);
+void						export_ply(t_mesh *mesh, const char *path);
+void						export_stl(t_mesh *mesh, const char *path);
+void						export_glb(t_mesh *mesh, const char *path);
+void						reorder_triangles(uint *idx, size_t num_tris, const float *v,
+								size_t stride, size_t num_v, uint threads);
+void						reorder_mesh(t_mesh *mesh, uint threads);
+
+void						run_headless(t_data *data);
+void						run_viewer(t_data *data);
 void						write_mesh(t_data *data, int surface, obj *o);
+void						stream_slab(FILE *out, t_mesh *slab, uint *remap, size_t base);
 
 #endif
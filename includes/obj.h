@@ -52,6 +52,8 @@ void obj_delete(obj *);
 int  obj_add_mtrl(obj *);
 int  obj_add_vert(obj *);
 int  obj_add_poly(obj *, int);
+int  obj_add_verts(obj *, int, const float *, int);
+int  obj_add_polys(obj *, int, int, const unsigned int *, int);
 int  obj_add_line(obj *, int);
 int  obj_add_surf(obj *);
 
@@ -83,6 +85,7 @@ void obj_set_vert_u(obj *, int, const float *);
 
 void obj_set_poly(obj *, int, int, const int *);
 void obj_set_line(obj *, int, int, const int *);
+void obj_set_polys(obj *, int, const unsigned int *);
 void obj_set_surf(obj *, int, int);
 
 void obj_set_vert_loc(obj *, int, int, int, int);
@@ -100,8 +103,10 @@ void         obj_get_mtrl_s   (const obj *, int, int, float *);
 void obj_get_vert_v(const obj *, int, float *);
 void obj_get_vert_t(const obj *, int, float *);
 void obj_get_vert_n(const obj *, int, float *);
+void obj_get_verts(const obj *, float *, int);
 
 void obj_get_poly(const obj *, int, int, int *);
+void obj_get_polys(const obj *, int, unsigned int *);
 void obj_get_line(const obj *, int, int, int *);
 int  obj_get_surf(const obj *, int);
 
@@ -118,12 +123,13 @@ unsigned int obj_load_image(const char *);
 void  obj_mini(obj *);
 void  obj_norm(obj *);
 void  obj_proc(obj *);
-void  obj_uniq(obj *, float, float, int);
+void  obj_uniq(obj *, float, float, int, int);
 void  obj_sort(obj *, int);
 float obj_acmr(obj *, int);
+float obj_acmr_index(const unsigned int *, int, int, int);
 
 void  obj_bound(const obj *, float *);
-void  obj_write(const obj *, const char *, const char *, int);
+int   obj_write(const obj *, const char *, const char *, int, int);
 
 /*======================================================================+=====*/
 
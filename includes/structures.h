@@ -1,7 +1,20 @@
 #pragma once
 
+# include <pthread.h>
+# include <stdint.h>
 # include <lib_complex.h>
 
+/*
+** How a sample's orbit ended, see julia_escape_path: the build counts
+** each in paths[PATH_COUNT].
+*/
+
+# define PATH_ESCAPED 0
+# define PATH_BOUNDED 1
+# define PATH_PERIODIC 2
+# define PATH_OVERTURNED 3
+# define PATH_COUNT 4
+
 typedef struct 				s_matrix
 {
 	mat4 					model_mat;
@@ -64,8 +77,10 @@ typedef struct 				s_gl
 
 	GLuint 					vbo;
 	GLuint 					vao;
+	GLuint 					ebo;
 
 	float					*tris;
+	uint					*indices;		// borrowed from data->mesh
 	uint 					num_pts;
 	uint					num_tris;
 	t_matrix 				*matrix;
@@ -74,6 +89,8 @@ typedef struct 				s_gl
 
 typedef struct 				s_julia
 {
+	int						field;
+	int						periodicity;
 	uint					max_iter;
 	float 					threshold;
 	float 					w;
@@ -89,11 +106,44 @@ typedef struct 				s_grid
 
 typedef struct 				s_voxel
 {
-	float 					dx;
-	float 					dy;
-	float 					dz;
+	uint 					dx;
+	uint 					dy;
+	uint 					dz;
 }							t_voxel;
 
+/*
+** A cell edge runs from corner a to corner b along axis (0 x, 1 y, 2 z).
+** a is always the lower lattice end, which is at offset (dx, dy, dz).
+*/
+
+typedef struct 				s_edge
+{
+	uint 					a;
+	uint 					b;
+	uint 					dx;
+	uint 					dy;
+	uint 					dz;
+	uint 					axis;
+}							t_edge;
+
+/*
+** Marching cubes case, derived once from edgetable and tritable: the
+** edges the surface crosses, in edge order, and the triangles as indices
+** into that list. For surface nets, axes has bit a set when the edge along
+** axis a leaving the lower corner is crossed, and lower_in tells whether
+** that corner is inside.
+*/
+
+typedef struct				s_case
+{
+	unsigned char			num_edges;
+	unsigned char			num_idx;
+	unsigned char			edges[12];
+	unsigned char			idx[15];
+	unsigned char			axes;
+	unsigned char			lower_in;
+}							t_case;
+
 typedef struct				s_fract
 {
 	float3 					p0;
@@ -105,15 +155,402 @@ typedef struct				s_fract
 	t_julia 				*julia;
 	t_grid 					grid;
 	t_voxel 				voxel[8];
+	t_edge 					edge[12];
+	t_case					cases[256];
 }							t_fract;
 
+/*
+** Indexed triangle mesh: num_idx / 3 triangles over num_v shared vertices.
+** ordered is set once reorder_mesh has put the triangles in vertex cache
+** order, and cleared when the mesh is built again.
+*/
+
+typedef struct 				s_mesh
+{
+	float3					*v;
+	uint					*idx;
+	size_t					num_v;
+	size_t					num_idx;
+	size_t					cap_v;
+	size_t					cap_idx;
+	int						ordered;
+}							t_mesh;
+
+/*
+** Buffered output of the binary exporters: values are packed little-endian
+** into buf and reach the file WRITE_CHUNK bytes at a time.
+*/
+
+typedef struct 				s_writer
+{
+	FILE					*out;
+	unsigned char			*buf;
+	size_t					len;
+}							t_writer;
+
+/*
+** Triangle order of an index buffer, see reorder_triangles: the buffer is
+** cut into chunks of VCACHE_CHUNK triangles, and next hands them out.
+*/
+
+typedef struct 				s_reorder
+{
+	uint					*idx;
+	size_t					num_tris;
+	const float				*v;
+	size_t					stride;
+	float					centre[3];
+	size_t					next;
+}							t_reorder;
+
+/*
+** A run of the order of one chunk drawn as a whole: count triangles from
+** first, sorted on key.
+*/
+
+typedef struct 				s_cluster
+{
+	float					key;
+	size_t					first;
+	size_t					count;
+}							t_cluster;
+
+/*
+** Scratch of one reordering worker. The per vertex arrays cover the index
+** range of the chunk, and grow with it.
+*/
+
+typedef struct 				s_tipsify
+{
+	uint					*live;
+	uint					*stamp;
+	uint					*offs;
+	uint					*adj;
+	uint					*stack;
+	uint					*order;
+	uint					*tris;
+	unsigned char			*done;
+	t_cluster				*clusters;
+	size_t					cap_v;
+}							t_tipsify;
+
+/*
+** One marching cubes cell: corner positions and values, and for each edge
+** its case crosses, in the order of the case, the slot of the edge cache
+** that holds the edge's vertex.
+*/
+
+typedef struct 				s_cell
+{
+	uint 					cubeindex;
+	float3					pos[8];
+	float					val[8];
+	uint					*slot[12];
+}							t_cell;
+
+typedef struct 				s_opts
+{
+	uint					threads;
+	int						field;
+	int						mesher;
+	int						format;
+	float					weld;
+	int						octree;
+	int						symmetry;
+	int						periodicity;
+	char					*orbits;
+	uint					refine;
+	char					*stream_out;
+	char					*output;
+	int						headless;
+	int						iter;
+}							t_opts;
+
+/*
+** Wall time of each pipeline stage, in seconds. Sampling and meshing run
+** interleaved inside the build, so theirs are summed over the workers.
+*/
+
+typedef struct 				s_timing
+{
+	double					grid;
+	double					octree;
+	double					build;
+	double					sample;
+	double					mesh;
+	double					export;
+}							t_timing;
+
 typedef struct 				s_data
 {
 	t_gl					*gl;
 	t_fract 				*fract;
-	float3 					*vertexpos;
-	float					*vertexval;
-	float3					**triangles;
-
-	uint2 					len;
+	t_opts					opts;
+	t_mesh					mesh;
+	t_timing				timing;
 }							t_data;
+
+/*
+** Orbit state of a run of the binary field, kept for a later run with more
+** iterations (--orbits). For each lattice row, escaped has the points that
+** escape within max_iter iterations and stored those whose orbit is kept:
+** its point after max_iter iterations, 4 floats in z, in lattice order.
+** first is the index of the first orbit of each row.
+*/
+
+typedef struct 				s_orbits
+{
+	size_t					n;
+	size_t					words;
+	uint					max_iter;
+	uint64_t				*escaped;
+	uint64_t				*stored;
+	float					*z;
+	size_t					*first;
+}							t_orbits;
+
+/*
+** What an orbit file is valid for, followed by the planes in order: the
+** escaped and stored words of each row, the number of orbits, the orbits.
+*/
+
+typedef struct 				s_orbit_header
+{
+	char					magic[8];
+	uint32_t				n;
+	uint32_t				max_iter;
+	float					origin[3];
+	float					step;
+	float					w;
+	float					c[4];
+}							t_orbit_header;
+
+/*
+** Orbit state of the planes a slab owns, in the layout of the file: bits
+** has the escaped and stored words of each row, counts the orbits of each
+** plane and z the orbits themselves.
+*/
+
+typedef struct 				s_record
+{
+	uint64_t				*bits;
+	size_t					*counts;
+	size_t					planes;
+	float					*z;
+	size_t					num_z;
+	size_t					cap_z;
+}							t_record;
+
+/*
+** The field of one --refine level, kept for the next one: the step and
+** the three axes of its lattice, the occupancy rows of every plane, and
+** the values when the field is not binary.
+*/
+
+typedef struct 				s_level
+{
+	size_t					n;
+	size_t					words;
+	float					step;
+	float					*axis;
+	uint64_t				*bits;
+	float					*vals;
+}							t_level;
+
+/*
+** A slab is a run of z planes [z0, z1) meshed by one worker. Slabs are
+** committed to data->mesh strictly in order, so the mesh does not depend
+** on the number of workers. bottom and top map the edges of planes z0 and
+** z1 to slab vertices, so vertices on the planes shared with the
+** neighbouring slabs can be welded at commit. With surface nets they map
+** the cells of the layers below z0 and below z1 instead.
+*/
+
+typedef struct 				s_slab
+{
+	size_t					z0;
+	size_t					z1;
+	t_mesh					mesh;
+	uint					*bottom;
+	uint					*top;
+	t_record				*record;
+}							t_slab;
+
+/*
+** Per-brick states of the adaptive octree, nb^3 bricks over n^3 cells.
+*/
+
+typedef struct 				s_octree
+{
+	unsigned char			*bricks;
+	size_t					n;
+	size_t					nb;
+	size_t					blocks;
+}							t_octree;
+
+/*
+** Sign flips of the lattice that map the set onto itself, as masks of
+** MIRROR_X, MIRROR_Y and MIRROR_Z, -1 when there is none. Planes above the
+** middle are copied from the plane mirrored through plane, rows above the
+** middle of a plane from the row mirrored through row, and the right half
+** of a row from its left half when point is set. The planes below the
+** middle are kept for that, ready[z] set once plane z is in.
+*/
+
+typedef struct 				s_symmetry
+{
+	int						plane;
+	int						row;
+	int						point;
+	float					*vals;
+	uint64_t				*bits;
+	unsigned char			*ready;
+	pthread_cond_t			stored;
+}							t_symmetry;
+
+/*
+** Items [lo, hi) of a job, run by run(arg, worker, lo, hi) in pieces of at
+** most grain items. pending counts the items of the job not done yet.
+*/
+
+typedef struct 				s_task
+{
+	void					(*run)(void *, uint, size_t, size_t);
+	void					*arg;
+	size_t					lo;
+	size_t					hi;
+	size_t					grain;
+	size_t					*pending;
+}							t_task;
+
+/*
+** The tasks of one worker, tasks[head] to tasks[tail - 1], and what it did:
+** tasks run, tasks stolen from others, seconds spent waiting for work.
+*/
+
+typedef struct 				s_deque
+{
+	t_task					*tasks;
+	size_t					head;
+	size_t					tail;
+	size_t					cap;
+	size_t					ran;
+	size_t					stolen;
+	double					idle;
+	pthread_mutex_t			lock;
+}							t_deque;
+
+typedef struct 				s_pool
+{
+	t_deque					*deques;
+	uint					count;
+	size_t					epoch;
+	uint					sleepers;
+	pthread_mutex_t			lock;
+	pthread_cond_t			wake;
+}							t_pool;
+
+/*
+** 64 cells of one row of a layer, see occupancy_window.
+*/
+
+typedef struct 				s_window
+{
+	uint64_t				lo[4];
+	uint64_t				hi[4];
+	uint64_t				active;
+}							t_window;
+
+/*
+** Scratch owned by one build worker: the occupancy bits of the two planes
+** around the current layer, their field values when the field is not
+** binary, the rows the batched sampler reads from and writes to, and the
+** edge cache. The cache holds the x and y edges of both planes and the z
+** edges between them; surface nets keep the vertices of the cells of the
+** layer below and of the current layer in eplanes instead. With --orbits,
+** cold and warm are the orbits started from the lattice and continued
+** from the last run, and record the state of the planes of the current
+** slab.
+*/
+
+typedef struct 				s_worker
+{
+	float					*field;
+	float					*planes[2];
+	uint64_t				*occupancy;
+	uint64_t				*bits[2];
+	float					*xs;
+	float					*ys;
+	float					*zs;
+	float					*vals;
+	float					*row;
+	unsigned char			*state;
+	unsigned char			*col;
+	unsigned char			*path;
+	unsigned char			*kind;
+	float					*orbit;
+	float					*cold[4];
+	float					*warm[4];
+	t_record				record;
+	uint					*edges;
+	uint					*eplanes[2];
+	uint					*zedges;
+	uint					*bottom;
+	size_t					samples;
+	size_t					resumed;
+	size_t					reused;
+	size_t					paths[PATH_COUNT];
+	double					sample_time;
+	double					mesh_time;
+}							t_worker;
+
+typedef struct 				s_build
+{
+	t_data					*data;
+	t_worker				*workers;
+	uint					joined;
+	t_pool					pool;
+	t_octree				*octree;
+	t_symmetry				*sym;
+	t_orbits				*prev;
+	FILE					*orbit_out;
+	t_level					*coarse;
+	t_level					*keep;
+	int						mesher;
+	size_t					samples;
+	size_t					resumed;
+	size_t					kept;
+	size_t					reused;
+	size_t					paths[PATH_COUNT];
+	double					sample_time;
+	double					mesh_time;
+	size_t					n;
+	size_t					words;
+	size_t					depth;
+	size_t					num_slabs;
+	size_t					next;
+	size_t					committed;
+	uint					*seam;
+	uint					*remap;
+	size_t					remap_cap;
+	size_t					num_v;
+	size_t					num_tris;
+	FILE					*stream;
+	pthread_mutex_t			lock;
+}							t_build;
+
+/*
+** Plane z of the build being sampled into vals and bits by row tasks, rec
+** the orbit record of its rows. pending counts the rows not done yet.
+*/
+
+typedef struct 				s_plane
+{
+	t_build					*b;
+	size_t					z;
+	size_t					span;
+	float					*vals;
+	uint64_t				*bits;
+	uint64_t				*rec;
+	size_t					pending;
+}							t_plane;
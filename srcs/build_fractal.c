@@ -1,46 +1,846 @@
 #include "morphosis.h"
 
-void						build_fractal(t_data *data)
+/*
+** Samples count points of row (y, z) through the batched sampler, their x
+** coordinates in x. With the periodicity check on, the path that decided
+** each point is tallied for the report.
+*/
+
+static void					sample_batch(t_build *b, t_worker *w, const float *x,
+								size_t y, size_t z, size_t count, float *out)
+{
+	t_fract					*f;
+	unsigned char			*path;
+
+	f = b->data->fract;
+	for (size_t i = 0; i < count; i++)
+	{
+		w->ys[i] = f->grid.y[y];
+		w->zs[i] = f->grid.z[z];
+	}
+	path = (f->julia->periodicity != PERIODICITY_OFF) ? w->path : NULL;
+	sample_4D_Julia_batch(f->julia, x, w->ys, w->zs, count, out, path);
+	w->samples += count;
+	if (path)
+		for (size_t i = 0; i < count; i++)
+			w->paths[path[i]]++;
+}
+
+/*
+** Next point of the row to look at after x: the point itself when it is
+** not known yet. Settled points always cover the rest of their brick, up
+** to the next boundary, which may belong to an unknown brick again.
+*/
+
+static size_t				next_unknown(t_worker *w, size_t x)
+{
+	if (w->state[x] == BLOCK_UNKNOWN)
+		return x;
+	return x - x % BRICK_SIZE + BRICK_SIZE;
+}
+
+/*
+** Samples the first span points of row y that are not known yet, gathered
+** into one batch. Points the octree settled take the value of their
+** bricks, a settled brick at a time, and on a row of the coarser --refine
+** level its points take the value they had there.
+*/
+
+static void					sample_row_sparse(t_build *b, t_worker *w, size_t y, size_t z,
+								size_t span, float *row)
 {
 	t_fract 				*f;
-	float3 					**new_tris;
-	size_t 					i;
-	uint2					pos;
-
-	i = 0;
-	f = data->fract;
-	data->len.x = 0;
-	data->len.y = 0;
-	pos.x = 0;
-	pos.y = 0;
-	new_tris = NULL;
-	
-	for (size_t z = 0; z < f->grid_size; z++)
-	{
-		printf("%zu/%.0f\n", (z + 1), f->grid_size);
-        for (size_t y = 0; y < f->grid_size; y++)
+	size_t					count;
+	int						shared;
+
+	f = b->data->fract;
+	if (b->octree)
+		lattice_row_state(b->octree, y, z, w->state, w->col);
+	else
+		memset(w->state, BLOCK_UNKNOWN, span);
+	shared = b->coarse && !(y & 1) && !(z & 1);
+	for (size_t x = 0; x < span; x++)
+		row[x] = (w->state[x] == BLOCK_INSIDE) ? 1.0f : 0.0f;
+	count = 0;
+	for (size_t x = next_unknown(w, 0); x < span; x = next_unknown(w, x + 1))
+	{
+		if (shared && !(x & 1))
 		{
-            for (size_t x = 0; x < f->grid_size; x++)
+			row[x] = level_value(b->coarse, x / 2, y / 2, z / 2);
+			w->reused++;
+		}
+		else
+			w->xs[count++] = f->grid.x[x];
+	}
+	if (!count)
+		return;
+	sample_batch(b, w, w->xs, y, z, count, w->vals);
+	count = 0;
+	for (size_t x = next_unknown(w, 0); x < span; x = next_unknown(w, x + 1))
+		if (!(shared && !(x & 1)))
+			row[x] = w->vals[count++];
+}
+
+/*
+** Fills row y of the plane from a row it mirrors, when a symmetry maps it
+** onto one that is already sampled: the matching row of the stored plane
+** below the middle, or, when in_plane is set, a row below the middle of
+** this plane. The bits are copied as they are, or reversed for a flip
+** along x. Returns 0 when y has no such row, -1 when it mirrors a row of
+** this plane and in_plane is not set.
+*/
+
+static int					mirror_row(t_plane *pl, size_t y, int in_plane)
+{
+	t_symmetry				*s;
+	const float				*vals;
+	const uint64_t			*bits;
+	size_t					n;
+	size_t					src;
+	int						flip;
+
+	s = pl->b->sym;
+	n = pl->b->n;
+	if (s->plane >= 0 && n - pl->z < pl->z)
+	{
+		flip = s->plane;
+		src = (n - pl->z) * (n + 1) + ((flip & MIRROR_Y) ? n - y : y);
+		bits = s->bits + src * pl->b->words;
+		vals = s->vals ? s->vals + src * (n + 1) : NULL;
+	}
+	else if (s->row >= 0 && n - y < y)
+	{
+		if (!in_plane)
+			return -1;
+		flip = s->row;
+		bits = pl->bits + (n - y) * pl->b->words;
+		vals = pl->vals ? pl->vals + (n - y) * (n + 1) : NULL;
+	}
+	else
+		return 0;
+	if (flip & MIRROR_X)
+		reverse_row(bits, pl->bits + y * pl->b->words, n, pl->b->words);
+	else
+		memcpy(pl->bits + y * pl->b->words, bits, pl->b->words * sizeof(uint64_t));
+	if (vals)
+		for (size_t x = 0; x <= n; x++)
+			pl->vals[y * (n + 1) + x] = vals[(flip & MIRROR_X) ? n - x : x];
+	return 1;
+}
+
+/*
+** Row task: samples rows [lo, hi) of the plane through the batched
+** sampler, with the scratch of worker me. Rows that mirror a row of the
+** same plane are left for sample_plane.
+*/
+
+static void					sample_rows(void *arg, uint me, size_t lo, size_t hi)
+{
+	t_plane					*pl;
+	t_build					*b;
+	t_worker				*w;
+	t_fract 				*f;
+	float					*row;
+
+	pl = (t_plane *)arg;
+	b = pl->b;
+	w = &b->workers[me];
+	f = b->data->fract;
+	for (size_t y = lo; y < hi; y++)
+	{
+		if (b->sym && mirror_row(pl, y, 0))
+			continue;
+		row = pl->vals ? pl->vals + y * (b->n + 1) : w->row;
+		if (b->orbit_out)
+			sample_row_orbits(b, w, y, pl->z, pl->span, row,
+				pl->rec ? pl->rec + y * 2 * b->words : NULL);
+		else if (b->octree || (b->coarse && !(y & 1) && !(pl->z & 1)))
+			sample_row_sparse(b, w, y, pl->z, pl->span, row);
+		else
+			sample_batch(b, w, f->grid.x, y, pl->z, pl->span, row);
+		for (size_t x = pl->span; x <= b->n; x++)
+			row[x] = row[b->n - x];
+		pack_row(row, b->n + 1, pl->bits + y * b->words, b->words);
+	}
+}
+
+/*
+** Samples every lattice point of plane z once into slot p of the rolling
+** buffer. Cells read their corners from the two planes around them
+** instead of sampling them again. Only the occupancy bits are kept unless
+** the field carries distances. The rows are split into about ROW_TASKS
+** tasks per worker, which idle workers steal. Rows run here, serially and
+** in order, when orbit state is recorded, since it is kept in lattice
+** order, or when there is a single worker. With symmetry, mirrored rows
+** and half rows are copied instead, and the planes that others mirror are
+** stored. With orbit state, the planes the slab owns are recorded: z0
+** belongs to the slab below, except plane 0. The planes it owns are also
+** kept for the next --refine level.
+*/
+
+static void					sample_plane(t_build *b, t_worker *w, size_t z, int p)
+{
+	t_plane					pl;
+	t_task					task;
+	size_t					n;
+	uint					me;
+	size_t					start;
+
+	n = b->n;
+	me = (uint)(w - b->workers);
+	if (b->sym && b->sym->plane >= 0 && n - z < z)
+		wait_plane(b->sym, &b->lock, n - z);
+	pl.b = b;
+	pl.z = z;
+	pl.span = (b->sym && b->sym->point) ? n / 2 + 1 : n + 1;
+	pl.vals = w->planes[p];
+	pl.bits = w->bits[p];
+	pl.rec = NULL;
+	pl.pending = n + 1;
+	start = w->record.num_z;
+	if (b->orbit_out && (p == 1 || z == 0))
+	{
+		pl.rec = w->record.bits + w->record.planes * (n + 1) * 2 * b->words;
+		memset(pl.rec, 0, (n + 1) * 2 * b->words * sizeof(uint64_t));
+	}
+	if (b->orbit_out || b->pool.count == 1)
+		sample_rows(&pl, me, 0, n + 1);
+	else
+	{
+		task.run = sample_rows;
+		task.arg = &pl;
+		task.lo = 0;
+		task.hi = n + 1;
+		task.grain = (n + 1) / (ROW_TASKS * b->pool.count);
+		task.grain = task.grain ? task.grain : 1;
+		task.pending = &pl.pending;
+		pool_run(&b->pool, me, task);
+		pool_wait(&b->pool, me, &pl.pending, 0);
+	}
+	if (b->sym && !(b->sym->plane >= 0 && n - z < z))
+		for (size_t y = n / 2 + 1; y <= n; y++)
+			mirror_row(&pl, y, 1);
+	if (pl.rec)
+		w->record.counts[w->record.planes++] = w->record.num_z - start;
+	if (b->sym && b->sym->plane >= 0 && z < n - z && (p == 1 || z == 0))
+		store_plane(b->sym, &b->lock, z, w->planes[p], w->bits[p], n, b->words);
+	if (b->keep && (p == 1 || z == 0))
+		keep_plane(b->keep, z, w->planes[p], w->bits[p]);
+}
+
+/*
+** Edge cache slot of edge e of cell (x, y) in the current layer: x and y
+** edges live in the plane of their lower end, z edges between the planes.
+*/
+
+static uint					*edge_slot(t_worker *w, t_edge *e, size_t n, size_t x, size_t y)
+{
+	size_t					i;
+
+	i = (y + e->dy) * (n + 1) + x + e->dx;
+	if (e->axis == 2)
+		return w->zedges + i;
+	return w->eplanes[e->dz] + e->axis * (n + 1) * (n + 1) + i;
+}
+
+/*
+** Vertex of cell i of the layer below z. Below the first layer of the
+** slab the cells belong to the previous slab: they get a stand-in here,
+** kept in bottom, that commit_slab maps onto the previous slab's vertex
+** through the seam, the way shared edge vertices are welded.
+*/
+
+static uint					net_below(t_slab *slab, t_worker *w, size_t i)
+{
+	if (w->eplanes[0][i] == EDGE_NONE)
+	{
+		mesh_reserve_v(&slab->mesh, 1);
+		w->eplanes[0][i] = (uint)slab->mesh.num_v++;
+	}
+	return w->eplanes[0][i];
+}
+
+/*
+** Surface nets faces of cell (x, y) of layer z: a quad for each crossed
+** edge leaving its lower corner, over the four cells around the edge.
+** Those are this cell and cells before it, in this layer or the one
+** below, so their vertices are all placed. Edges on the lower faces of
+** the lattice have no cells on one side and no quad.
+*/
+
+static void					net_quads(t_slab *slab, t_worker *w, t_case *cs,
+								size_t i, size_t row, int at[3])
+{
+	uint					*cur;
+	uint					q[4];
+	uint					*dst;
+
+	cur = w->eplanes[1];
+	for (int a = 0; a < 3; a++)
+	{
+		if (!((cs->axes >> a) & 1) || !at[(a + 1) % 3] || !at[(a + 2) % 3])
+			continue;
+		q[0] = cur[i];
+		if (a == 0)
+		{
+			q[1] = cur[i - row];
+			q[2] = net_below(slab, w, i - row);
+			q[3] = net_below(slab, w, i);
+		}
+		else if (a == 1)
+		{
+			q[1] = net_below(slab, w, i);
+			q[2] = net_below(slab, w, i - 1);
+			q[3] = cur[i - 1];
+		}
+		else
+		{
+			q[1] = cur[i - 1];
+			q[2] = cur[i - 1 - row];
+			q[3] = cur[i - row];
+		}
+		dst = mesh_reserve_idx(&slab->mesh, 6);
+		dst[0] = q[0];
+		dst[1] = q[cs->lower_in ? 1 : 3];
+		dst[2] = q[2];
+		dst[3] = q[0];
+		dst[4] = q[2];
+		dst[5] = q[cs->lower_in ? 3 : 1];
+		slab->mesh.num_idx += 6;
+	}
+}
+
+/*
+** Visits the active cells of layer z a row at a time, 64 cells per
+** occupancy window, so runs of cells that are all out or all in are never
+** looked at one by one. Marching cubes polygonises each cell; surface
+** nets give it one vertex and join it to the cells placed before it.
+*/
+
+static void					mesh_layer(t_build *b, t_slab *slab, t_worker *w, size_t z)
+{
+	t_fract 				*f;
+	t_voxel					*c;
+	t_case					*cs;
+	t_cell					cell;
+	t_window				win;
+	uint64_t				*rows[4];
+	size_t					n;
+	size_t					x;
+	uint					j;
+	float					bias;
+	int						at[3];
+
+	f = b->data->fract;
+	n = b->n;
+	bias = (b->mesher == MESHER_NETS) ? 0.5f : 0.0f;
+	at[2] = (z > 0);
+	for (size_t y = 0; y < n; y++)
+	{
+		rows[0] = w->bits[0] + (y + 1) * b->words;
+		rows[1] = w->bits[0] + y * b->words;
+		rows[2] = w->bits[1] + (y + 1) * b->words;
+		rows[3] = w->bits[1] + y * b->words;
+		for (size_t k = 0; 64 * k < n; k++)
+		{
+			occupancy_window(rows, k, n, &win);
+			while (win.active)
 			{
-                for (int c = 0; c < 8; c++)
+				j = (uint)__builtin_ctzll(win.active);
+				win.active &= win.active - 1;
+				x = 64 * k + j;
+				if (b->octree && brick_state(b->octree, x, y, z) != BLOCK_UNKNOWN)
+					continue;
+				cell.cubeindex = window_case(&win, j);
+				cs = &f->cases[cell.cubeindex];
+				for (int i = 0; i < 8; i++)
 				{
-					data->vertexpos[i].x = f->grid.x[x] + f->voxel[c].dx;
-					data->vertexpos[i].y = f->grid.y[y] + f->voxel[c].dy;
-					data->vertexpos[i].z = f->grid.z[z] + f->voxel[c].dz;
-					data->vertexval[i] = sample_4D_Julia(f->julia, data->vertexpos[i]);
-					i++;
+					c = &f->voxel[i];
+					if (w->planes[0])
+						cell.val[i] = w->planes[c->dz][(y + c->dy) * (n + 1) + x + c->dx];
+					else
+						cell.val[i] = (float)((cell.cubeindex >> i) & 1) - bias;
+					cell.pos[i].x = f->grid.x[x + c->dx];
+					cell.pos[i].y = f->grid.y[y + c->dy];
+					cell.pos[i].z = f->grid.z[z + c->dz];
 				}
-				pos.y += 8;
-				new_tris = polygonise(data->vertexpos, data->vertexval, &pos, data);
-				if (new_tris)
+				if (b->mesher == MESHER_NETS)
 				{
-					if (!(data->triangles = arr_float3_cat(new_tris, data->triangles, &data->len)))
-						error(MALLOC_FAIL_ERR, data);
+					w->eplanes[1][y * (n + 1) + x] = net_vertex(&cell, cs, f->edge, &slab->mesh);
+					at[0] = (x > 0);
+					at[1] = (y > 0);
+					net_quads(slab, w, cs, y * (n + 1) + x, n + 1, at);
+					continue;
 				}
-				pos.x = pos.y;
+				for (uint e = 0; e < cs->num_edges; e++)
+					cell.slot[e] = edge_slot(w, &f->edge[cs->edges[e]], n, x, y);
+				polygonise(&cell, cs, f->edge, &slab->mesh);
 			}
 		}
 	}
-	data->gl->num_tris = data->len.x;
-	data->gl->num_pts = data->len.x * 3 * 3;
+}
+
+static void					clear_edges(uint *edges, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		edges[i] = EDGE_NONE;
+}
+
+/*
+** Sweeps the slab with a two-plane rolling buffer: plane z is kept from
+** the previous layer and only plane z + 1 is sampled. The edge cache rolls
+** with it. The slab's mesh is reused from one slab to the next.
+*/
+
+static void					build_slab(t_build *b, t_slab *slab, t_worker *w)
+{
+	size_t					plane;
+	float					*swap;
+	uint64_t				*bswap;
+	uint					*eswap;
+	double					start;
+	double					split;
+
+	plane = (b->n + 1) * (b->n + 1);
+	slab->mesh.num_v = 0;
+	slab->mesh.num_idx = 0;
+	w->record.planes = 0;
+	w->record.num_z = 0;
+	clear_edges(w->eplanes[0], 2 * plane);
+	start = wall_time();
+	sample_plane(b, w, slab->z0, 0);
+	for (size_t z = slab->z0; z < slab->z1; z++)
+	{
+		clear_edges(w->eplanes[1], 2 * plane);
+		clear_edges(w->zedges, plane);
+		sample_plane(b, w, z + 1, 1);
+		split = wall_time();
+		w->sample_time += split - start;
+		mesh_layer(b, slab, w, z);
+		start = wall_time();
+		w->mesh_time += start - split;
+		if (z == slab->z0)
+			memcpy(w->bottom, w->eplanes[0], 2 * plane * sizeof(uint));
+		swap = w->planes[0];
+		w->planes[0] = w->planes[1];
+		w->planes[1] = swap;
+		bswap = w->bits[0];
+		w->bits[0] = w->bits[1];
+		w->bits[1] = bswap;
+		eswap = w->eplanes[0];
+		w->eplanes[0] = w->eplanes[1];
+		w->eplanes[1] = eswap;
+	}
+	slab->bottom = w->bottom;
+	slab->top = w->eplanes[0];
+	slab->record = &w->record;
+}
+
+/*
+** Appends a committed slab to the in-memory mesh: the vertices remapped to
+** base or above are new, the others are already there.
+*/
+
+static void					append_slab(t_mesh *mesh, t_mesh *slab, uint *remap, size_t base)
+{
+	uint					*idx;
+
+	mesh_reserve_v(mesh, slab->num_v);
+	for (size_t i = 0; i < slab->num_v; i++)
+		if (remap[i] >= base)
+		{
+			mesh->v[remap[i]] = slab->v[i];
+			mesh->num_v++;
+		}
+	idx = mesh_reserve_idx(mesh, slab->num_idx);
+	for (size_t i = 0; i < slab->num_idx; i++)
+		idx[i] = remap[slab->idx[i]];
+	mesh->num_idx += slab->num_idx;
+}
+
+/*
+** Called with b->lock held, once every earlier slab has been committed.
+** Vertices on plane z0 that the previous slab already emitted are mapped
+** onto its copies through b->seam, every other vertex gets the next global
+** index, and the seam is moved up to plane z1 for the next slab. The slab
+** then goes to the stream, or is appended to data->mesh.
+*/
+
+static void					commit_slab(t_build *b, t_slab *slab)
+{
+	size_t					edges;
+	size_t					base;
+
+	edges = 2 * (b->n + 1) * (b->n + 1);
+	if (slab->mesh.num_v > b->remap_cap)
+	{
+		b->remap_cap = slab->mesh.num_v;
+		free(b->remap);
+		if (!(b->remap = (uint *)malloc(b->remap_cap * sizeof(uint))))
+			error(MALLOC_FAIL_ERR, NULL);
+	}
+	clear_edges(b->remap, slab->mesh.num_v);
+	for (size_t e = 0; e < edges; e++)
+		if (slab->bottom[e] != EDGE_NONE && b->seam[e] != EDGE_NONE)
+			b->remap[slab->bottom[e]] = b->seam[e];
+	base = b->num_v;
+	for (size_t i = 0; i < slab->mesh.num_v; i++)
+		if (b->remap[i] == EDGE_NONE)
+			b->remap[i] = (uint)b->num_v++;
+	for (size_t e = 0; e < edges; e++)
+		b->seam[e] = (slab->top[e] != EDGE_NONE) ? b->remap[slab->top[e]] : EDGE_NONE;
+	b->num_tris += slab->mesh.num_idx / 3;
+	if (b->orbit_out)
+	{
+		write_record(b->orbit_out, slab->record, b->n, b->words);
+		b->kept += slab->record->num_z;
+	}
+	if (b->stream)
+		stream_slab(b->stream, &slab->mesh, b->remap, base);
+	else
+		append_slab(&b->data->mesh, &slab->mesh, b->remap, base);
+	printf("%zu/%.0f\n", slab->z1, b->data->fract->grid_size);
+}
+
+/*
+** Orbit scratch: the components of the cold and warm orbits of a row and
+** what became of them, and the record of up to depth + 1 planes.
+*/
+
+static void					init_record(t_worker *w, t_build *b)
+{
+	size_t					row_size;
+	t_record				*rec;
+
+	row_size = b->n + 1;
+	rec = &w->record;
+	memset(rec, 0, sizeof(*rec));
+	w->orbit = NULL;
+	if (!b->orbit_out)
+		return;
+	if (!(w->orbit = (float *)malloc(10 * row_size * sizeof(float))))
+		error(MALLOC_FAIL_ERR, NULL);
+	for (int c = 0; c < 4; c++)
+	{
+		w->cold[c] = w->orbit + c * row_size;
+		w->warm[c] = w->orbit + (4 + c) * row_size;
+	}
+	if (!(rec->bits = (uint64_t *)malloc((b->depth + 1) * row_size * 2 * b->words
+		* sizeof(uint64_t))))
+		error(MALLOC_FAIL_ERR, NULL);
+	if (!(rec->counts = (size_t *)malloc((b->depth + 1) * sizeof(size_t))))
+		error(MALLOC_FAIL_ERR, NULL);
+}
+
+/*
+** Field values are only kept for the distance field; the binary field is
+** fully described by the occupancy bits.
+*/
+
+static void					init_worker(t_worker *w, t_build *b)
+{
+	size_t					n;
+	size_t					plane_size;
+	size_t					row_size;
+	size_t					values;
+
+	n = b->n;
+	plane_size = (n + 1) * (n + 1);
+	row_size = n + 1;
+	values = (b->data->fract->julia->field == FIELD_BINARY) ? 0 : 2 * plane_size;
+	if (!(w->field = (float *)malloc((values + 5 * row_size) * sizeof(float))))
+		error(MALLOC_FAIL_ERR, NULL);
+	if (!(w->occupancy = (uint64_t *)malloc(2 * row_size * b->words * sizeof(uint64_t))))
+		error(MALLOC_FAIL_ERR, NULL);
+	if (!(w->state = (unsigned char *)malloc(4 * row_size)))
+		error(MALLOC_FAIL_ERR, NULL);
+	if (!(w->edges = (uint *)malloc(7 * plane_size * sizeof(uint))))
+		error(MALLOC_FAIL_ERR, NULL);
+	w->planes[0] = values ? w->field : NULL;
+	w->planes[1] = values ? w->field + plane_size : NULL;
+	w->bits[0] = w->occupancy;
+	w->bits[1] = w->occupancy + row_size * b->words;
+	w->xs = w->field + values;
+	w->ys = w->xs + row_size;
+	w->zs = w->ys + row_size;
+	w->vals = w->zs + row_size;
+	w->row = w->vals + row_size;
+	w->col = w->state + row_size;
+	w->path = w->col + row_size;
+	w->kind = w->path + row_size;
+	w->eplanes[0] = w->edges;
+	w->eplanes[1] = w->edges + 2 * plane_size;
+	w->zedges = w->edges + 4 * plane_size;
+	w->bottom = w->edges + 5 * plane_size;
+	w->samples = 0;
+	w->resumed = 0;
+	w->reused = 0;
+	for (int p = 0; p < PATH_COUNT; p++)
+		w->paths[p] = 0;
+	w->sample_time = 0.0;
+	w->mesh_time = 0.0;
+	init_record(w, b);
+}
+
+/*
+** Takes the next slab until there are none left. A worker waiting for its
+** turn to commit, or for the last slabs to be committed, runs the row
+** tasks of the others meanwhile.
+*/
+
+static void					*build_worker(void *arg)
+{
+	t_build					*b;
+	t_worker				*w;
+	t_slab					slab;
+	size_t					s;
+	uint					me;
+
+	b = (t_build *)arg;
+	pthread_mutex_lock(&b->lock);
+	me = b->joined++;
+	pthread_mutex_unlock(&b->lock);
+	w = &b->workers[me];
+	init_worker(w, b);
+	init_mesh(&slab.mesh);
+	while (1)
+	{
+		pthread_mutex_lock(&b->lock);
+		s = b->next++;
+		pthread_mutex_unlock(&b->lock);
+		if (s >= b->num_slabs)
+			break;
+		slab.z0 = s * b->depth;
+		slab.z1 = (slab.z0 + b->depth < b->n) ? slab.z0 + b->depth : b->n;
+		build_slab(b, &slab, w);
+
+		pool_wait(&b->pool, me, &b->committed, s);
+		pthread_mutex_lock(&b->lock);
+		commit_slab(b, &slab);
+		__atomic_add_fetch(&b->committed, 1, __ATOMIC_RELEASE);
+		pthread_mutex_unlock(&b->lock);
+		pool_wake(&b->pool);
+	}
+	pool_wait(&b->pool, me, &b->committed, b->num_slabs);
+	pthread_mutex_lock(&b->lock);
+	b->samples += w->samples;
+	b->resumed += w->resumed;
+	b->reused += w->reused;
+	for (int p = 0; p < PATH_COUNT; p++)
+		b->paths[p] += w->paths[p];
+	b->sample_time += w->sample_time;
+	b->mesh_time += w->mesh_time;
+	pthread_mutex_unlock(&b->lock);
+	free(w->field);
+	free(w->occupancy);
+	free(w->state);
+	free(w->edges);
+	free(w->orbit);
+	free(w->record.bits);
+	free(w->record.counts);
+	free(w->record.z);
+	clean_mesh(&slab.mesh);
+	return NULL;
+}
+
+/*
+** The slab depth only depends on the grid, never on the thread count:
+** the same slabs are committed in the same order whatever -j is set to.
+*/
+
+static size_t				slab_depth(size_t n)
+{
+	size_t					depth;
+
+	depth = n / SLAB_TARGET_COUNT;
+	if (depth < SLAB_MIN_DEPTH)
+		depth = SLAB_MIN_DEPTH;
+	return depth;
+}
+
+/*
+** Workers beyond the number of slabs have no slab of their own, but still
+** take row tasks from the others.
+*/
+
+static void					run_workers(t_build *b, uint threads)
+{
+	pthread_t				*workers;
+
+	threads = threads ? threads : 1;
+	init_pool(&b->pool, threads);
+	if (!(b->workers = (t_worker *)malloc(threads * sizeof(t_worker))))
+		error(MALLOC_FAIL_ERR, b->data);
+	if (threads == 1)
+		build_worker(b);
+	else
+	{
+		if (!(workers = (pthread_t *)malloc(threads * sizeof(pthread_t))))
+			error(MALLOC_FAIL_ERR, b->data);
+		for (uint t = 0; t < threads; t++)
+			if (pthread_create(&workers[t], NULL, build_worker, b))
+				error(THREAD_ERR, NULL);
+		for (uint t = 0; t < threads; t++)
+			pthread_join(workers[t], NULL);
+		free(workers);
+	}
+}
+
+/*
+** How evenly the pool spread the work: the tasks each worker ran, those it
+** stole, and the share of the build it spent busy, in total and then one
+** line per worker.
+*/
+
+static void					print_pool(t_pool *p, double elapsed)
+{
+	size_t					ran;
+	size_t					stolen;
+	double					busy;
+
+	ran = 0;
+	stolen = 0;
+	for (uint i = 0; i < p->count; i++)
+	{
+		ran += p->deques[i].ran;
+		stolen += p->deques[i].stolen;
+	}
+	printf("Workers: %u, %zu row tasks, %zu stolen\n", p->count, ran, stolen);
+	for (uint i = 0; i < p->count; i++)
+	{
+		busy = (elapsed > 0.0) ? 1.0 - p->deques[i].idle / elapsed : 1.0;
+		printf("  worker %-3u %8zu ran %8zu stolen   busy %3.0f%%\n",
+			i, p->deques[i].ran, p->deques[i].stolen, 100.0 * busy);
+	}
+}
+
+/*
+** Builds the mesh of the current lattice. coarse is the previous --refine
+** level, if any, and keep is filled with this one for the next.
+*/
+
+void						build_fractal(t_data *data, t_level *coarse, t_level *keep)
+{
+	t_build					b;
+	t_octree				octree;
+	t_symmetry				sym;
+	double					start;
+	double					elapsed;
+
+	b.data = data;
+	b.octree = NULL;
+	b.sym = NULL;
+	b.prev = NULL;
+	b.orbit_out = NULL;
+	b.coarse = NULL;
+	b.keep = keep;
+	b.mesher = data->opts.mesher;
+	b.samples = 0;
+	b.resumed = 0;
+	b.kept = 0;
+	b.reused = 0;
+	for (int p = 0; p < PATH_COUNT; p++)
+		b.paths[p] = 0;
+	b.sample_time = 0.0;
+	b.mesh_time = 0.0;
+	b.n = (size_t)data->fract->grid_size;
+	b.words = occupancy_words(b.n);
+	b.depth = slab_depth(b.n);
+	b.num_slabs = (b.n + b.depth - 1) / b.depth;
+	b.next = 0;
+	b.committed = 0;
+	pthread_mutex_init(&b.lock, NULL);
+	b.joined = 0;
+	b.remap = NULL;
+	b.remap_cap = 0;
+	if (!(b.seam = (uint *)malloc(2 * (b.n + 1) * (b.n + 1) * sizeof(uint))))
+		error(MALLOC_FAIL_ERR, data);
+	clear_edges(b.seam, 2 * (b.n + 1) * (b.n + 1));
+	b.num_v = 0;
+	b.num_tris = 0;
+	b.stream = NULL;
+	if (data->opts.stream_out && !(b.stream = fopen(data->opts.stream_out, "w")))
+		error(OPEN_FILE_ERR, data);
+	data->mesh.num_v = 0;
+	data->mesh.num_idx = 0;
+	data->mesh.ordered = 0;
+
+	if (data->opts.octree)
+	{
+		start = wall_time();
+		build_octree(&octree, data->fract, b.n);
+		b.octree = &octree;
+		data->timing.octree += wall_time() - start;
+	}
+	if (data->opts.orbits && data->fract->julia->field != FIELD_BINARY)
+		printf("Orbit state: only kept for the binary field\n");
+	else if (data->opts.orbits)
+	{
+		b.prev = load_orbits(data->opts.orbits, data->fract, b.n, b.words);
+		b.orbit_out = open_orbits(data->opts.orbits, data->fract, b.n);
+	}
+	if (coarse && level_fits(coarse, data->fract, b.n))
+		b.coarse = coarse;
+	else if (coarse)
+		printf("Refine: step %g does not line up with step %g, sampled whole\n",
+			data->fract->step_size, coarse->step);
+	if (keep)
+		init_level(keep, data->fract, b.n, b.words);
+	if (data->opts.symmetry)
+	{
+		init_symmetry(&sym, data->fract, b.n, b.words);
+		b.sym = &sym;
+	}
+	start = wall_time();
+	run_workers(&b, data->opts.threads);
+	elapsed = wall_time() - start;
+	data->timing.build += elapsed;
+	if (b.pool.count > 1)
+		print_pool(&b.pool, elapsed);
+	data->timing.sample += b.sample_time;
+	data->timing.mesh += b.mesh_time;
+	if (b.octree)
+	{
+		printf("Octree: %zu blocks classified, %zu of %zu lattice points sampled\n",
+			octree.blocks, b.samples, (b.n + 1) * (b.n + 1) * (b.n + 1));
+		free(octree.bricks);
+	}
+	if (b.sym)
+	{
+		printf("Symmetry: %zu of %zu lattice points sampled\n",
+			b.samples, (b.n + 1) * (b.n + 1) * (b.n + 1));
+		clean_symmetry(&sym);
+	}
+	if (b.coarse)
+		printf("Refine: %zu of %zu lattice points kept from step %g\n",
+			b.reused, (b.n + 1) * (b.n + 1) * (b.n + 1), coarse->step);
+	if (b.orbit_out)
+	{
+		close_orbits(b.orbit_out, data->opts.orbits);
+		printf("Orbit state: %zu orbits continued, %zu sampled from scratch, %zu kept in %s\n",
+			b.resumed, b.samples - b.resumed, b.kept, data->opts.orbits);
+	}
+	if (b.prev)
+		clean_orbits(b.prev);
+	if (data->fract->julia->periodicity != PERIODICITY_OFF && !b.orbit_out)
+		printf("Orbits: %zu escaped, %zu ran to max_iter, %zu cycled (%zu overturned)\n",
+			b.paths[PATH_ESCAPED], b.paths[PATH_BOUNDED],
+			b.paths[PATH_PERIODIC] + b.paths[PATH_OVERTURNED], b.paths[PATH_OVERTURNED]);
+	if (b.stream)
+	{
+		if (fclose(b.stream))
+			error(WRITE_FILE_ERR, data);
+		printf("Streamed %zu vertices, %zu triangles to %s\n",
+			b.num_v, b.num_tris, data->opts.stream_out);
+	}
+	else
+		printf("Mesh: %zu vertices, %zu triangles\n", b.num_v, b.num_tris);
+	free(b.seam);
+	free(b.remap);
+	pthread_mutex_destroy(&b.lock);
+	clean_pool(&b.pool);
+	free(b.workers);
+
+	data->gl->num_tris = data->mesh.num_idx / 3;
+	data->gl->num_pts = data->mesh.num_v * 3;
 }
@@ -2,12 +2,17 @@
 
 void 						clean_calcs(t_data *data)
 {
-	if (data->vertexpos && data->vertexval)
+	t_grid					*grid;
+
+	grid = &data->fract->grid;
+	if (grid->x && grid->y && grid->z)
 	{
-		free(data->vertexval);
-		free(data->vertexpos);
-		data->vertexval = NULL;
-		data->vertexpos = NULL;
+		free(grid->x);
+		free(grid->y);
+		free(grid->z);
+		grid->x = NULL;
+		grid->y = NULL;
+		grid->z = NULL;
 	}
 }
 
@@ -35,11 +40,60 @@ void						clean_gl(t_gl *gl)
 	free(gl);
 }
 
-void						clean_trigs(float3 **trigs, uint len)
+void						clean_mesh(t_mesh *mesh)
+{
+	free(mesh->v);
+	free(mesh->idx);
+	init_mesh(mesh);
+}
+
+void						clean_symmetry(t_symmetry *s)
+{
+	free(s->vals);
+	free(s->bits);
+	free(s->ready);
+	pthread_cond_destroy(&s->stored);
+}
+
+void						clean_orbits(t_orbits *o)
+{
+	free(o->escaped);
+	free(o->stored);
+	free(o->z);
+	free(o->first);
+	free(o);
+}
+
+void						clean_level(t_level *l)
+{
+	free(l->axis);
+	free(l->bits);
+	free(l->vals);
+}
+
+void						clean_pool(t_pool *p)
+{
+	for (uint i = 0; i < p->count; i++)
+	{
+		free(p->deques[i].tasks);
+		pthread_mutex_destroy(&p->deques[i].lock);
+	}
+	free(p->deques);
+	pthread_mutex_destroy(&p->lock);
+	pthread_cond_destroy(&p->wake);
+}
+
+void						clean_tipsify(t_tipsify *t)
 {
-	for (uint i = 0; i < len; i++)
-		free(trigs[i]);
-	free(trigs);
+	free(t->live);
+	free(t->stamp);
+	free(t->offs);
+	free(t->adj);
+	free(t->stack);
+	free(t->order);
+	free(t->tris);
+	free(t->done);
+	free(t->clusters);
 }
 
 void 						clean_up(t_data *data)
@@ -50,12 +104,7 @@ void 						clean_up(t_data *data)
 			clean_gl(data->gl);
 		if (data->fract)
 			clean_fract(data->fract);
-		if (data->vertexpos)
-			free(data->vertexpos);
-		if (data->vertexval)
-			free(data->vertexval);
-		if (data->triangles)
-			clean_trigs(data->triangles, data->len.x);
+		clean_mesh(&data->mesh);
 		free(data);
 	}
 }
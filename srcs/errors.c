@@ -54,6 +54,10 @@ void 						error(int errno, t_data *data)
 		printf("%s%s", NO_ARG, USAGE);
 	else if (errno == BAD_FILE_ERR)
 		printf(BAD_FILE);
+	else if (errno == THREAD_ERR)
+		printf(THREAD);
+	else if (errno == WRITE_FILE_ERR)
+		printf(WRITE_FILE);
 	clean_up(data);
 	exit(1);
 }
@@ -7,6 +7,13 @@ void 						createVBO(t_gl *gl, GLsizeiptr size, GLfloat *points)
 	glBufferData(GL_ARRAY_BUFFER, size, points, GL_DYNAMIC_DRAW);
 }
 
+void 						createEBO(t_gl *gl, GLsizeiptr size, GLuint *indices)
+{
+	glGenBuffers(1, &gl->ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl->ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, indices, GL_STATIC_DRAW);
+}
+
 void						createVAO(t_gl *gl)
 {
 	glGenVertexArrays(1, &gl->vao);
@@ -8,6 +8,7 @@ void 						run_graphics(t_gl *gl, float3 max, float3 min)
 	
 	createVAO(gl);
 	createVBO(gl, gl->num_pts * sizeof(float), (GLfloat *)gl->tris);
+	createEBO(gl, gl->num_tris * 3 * sizeof(GLuint), (GLuint *)gl->indices);
 
 	makeShaderProgram(gl);
 	gl_set_attrib_ptr(gl, "pos", 3,3, 0);
@@ -52,7 +53,7 @@ void							gl_render(t_gl *gl)
 		glm_rotate(gl->matrix->view_mat, (0.25f * delta * glm_rad(180.0f)), gl->matrix->up);
 		glUniformMatrix4fv(gl->matrix->view, 1, GL_FALSE, (float *)gl->matrix->view_mat);
 
-		glDrawArrays(GL_TRIANGLES, 0, gl->num_pts);
+		glDrawElements(GL_TRIANGLES, gl->num_tris * 3, GL_UNSIGNED_INT, 0);
 		
 		// Render UI on top of 3D scene
 		render_ui(gl);
@@ -26,23 +26,3 @@ t_matrix 					*initGlMatrices(void)
 	return matrix;
 }
 
-t_gl						*init_gl_struct(void)
-{
-	t_gl					*gl;
-
-	if (!(gl = (t_gl *)malloc(sizeof(t_gl))))
-		error(MALLOC_FAIL_ERR, NULL);
-	gl->window = NULL;
-	gl->export = 0;
-	gl->shaderProgram = 0;
-	gl->vertexShader = 0;
-	gl->fragmentShader = 0;
-	gl->vbo = 0;
-	gl->vao = 0;
-	gl->tris = NULL;
-	gl->num_pts = 0;
-	gl->matrix = initGlMatrices();
-	gl->ui = NULL;
-	return gl;
-}
-
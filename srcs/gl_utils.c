@@ -62,6 +62,7 @@ void 						terminate_gl(t_gl *gl)
 {
 	glDeleteVertexArrays(1, &gl->vao);
 	glDeleteBuffers(1, &gl->vbo);
+	glDeleteBuffers(1, &gl->ebo);
 	glDeleteProgram(gl->shaderProgram);
 	glfwTerminate();
 }
@@ -0,0 +1,23 @@
+#include "morphosis.h"
+
+/*
+** Interactive path: builds the mesh, shows it, and exports it if asked to
+** from the window. Builds without GL (morphosis_headless) leave this file
+** out and always take run_headless.
+*/
+
+void						run_viewer(t_data *data)
+{
+	calculate_point_cloud(data);
+	reorder_mesh(&data->mesh, data->opts.threads);
+	gl_retrieve_tris(data);
+	clean_calcs(data);
+	data->gl->matrix = initGlMatrices();
+	run_graphics(data->gl, data->fract->p1, data->fract->p0);
+	if (data->gl->export)
+	{
+		printf("\nEXPORTING----\n");
+		export_mesh(data);
+		printf("DONE\n");
+	}
+}
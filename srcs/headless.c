@@ -0,0 +1,35 @@
+#include "morphosis.h"
+
+static void					print_timing(t_timing *t)
+{
+	printf("\nTIMING (wall, s)\n");
+	printf("grid\t\t%.3f\n", t->grid);
+	printf("octree\t\t%.3f\n", t->octree);
+	printf("build\t\t%.3f\t(sampling %.3f, meshing %.3f summed over workers)\n",
+		t->build, t->sample, t->mesh);
+	printf("export\t\t%.3f\n", t->export);
+	printf("total\t\t%.3f\n", t->grid + t->octree + t->build + t->export);
+}
+
+/*
+** Batch pipeline: compute, mesh, export. Never touches GLFW, GLEW or the
+** shaders, so it runs on machines without a display. With --stream-out
+** the mesh is written during the build and there is nothing to export.
+*/
+
+void						run_headless(t_data *data)
+{
+	double					start;
+
+	calculate_point_cloud(data);
+	clean_calcs(data);
+	if (!data->opts.stream_out)
+	{
+		printf("\nEXPORTING----\n");
+		start = wall_time();
+		export_mesh(data);
+		data->timing.export += wall_time() - start;
+		printf("DONE\n");
+	}
+	print_timing(&data->timing);
+}
@@ -35,6 +35,8 @@ t_julia 					*init_julia(void)
 	if (!(julia = (t_julia *)malloc(sizeof(t_julia))))
 		error(MALLOC_FAIL_ERR, NULL);
 
+	julia->field = FIELD_BINARY;
+	julia->periodicity = PERIODICITY_OFF;
 	julia->max_iter = 6;
 	julia->threshold = 2.0f;
 	julia->w = 0.0f;
@@ -47,6 +49,51 @@ t_julia 					*init_julia(void)
 	return julia;
 }
 
+void						init_opts(t_opts *opts)
+{
+	opts->threads = 1;
+	opts->field = FIELD_BINARY;
+	opts->mesher = MESHER_CUBES;
+	opts->format = FORMAT_AUTO;
+	opts->weld = 0.0f;
+	opts->octree = 0;
+	opts->symmetry = 0;
+	opts->periodicity = PERIODICITY_OFF;
+	opts->orbits = NULL;
+	opts->refine = 1;
+	opts->stream_out = NULL;
+	opts->output = OUTPUT_FILE;
+	opts->headless = 0;
+	opts->iter = 0;
+}
+
+/*
+** The GL state starts empty: the viewer sets up its matrices when it
+** runs, so a build without GL never needs them.
+*/
+
+t_gl						*init_gl_struct(void)
+{
+	t_gl					*gl;
+
+	if (!(gl = (t_gl *)malloc(sizeof(t_gl))))
+		error(MALLOC_FAIL_ERR, NULL);
+	gl->window = NULL;
+	gl->export = 0;
+	gl->shaderProgram = 0;
+	gl->vertexShader = 0;
+	gl->fragmentShader = 0;
+	gl->vbo = 0;
+	gl->vao = 0;
+	gl->ebo = 0;
+	gl->tris = NULL;
+	gl->indices = NULL;
+	gl->num_pts = 0;
+	gl->matrix = NULL;
+	gl->ui = NULL;
+	return gl;
+}
+
 t_data						*init_data(void)
 {
 	t_data 					*data;
@@ -55,23 +102,12 @@ t_data						*init_data(void)
 		error(MALLOC_FAIL_ERR, NULL);
 	data->gl = init_gl_struct();
 	data->fract = init_fract();
-	data->vertexpos = NULL;
-	data->vertexval = NULL;
-	data->triangles = NULL;
+	init_opts(&data->opts);
+	init_mesh(&data->mesh);
+	bzero(&data->timing, sizeof(t_timing));
 	return data;
 }
 
-void						init_vertex(t_data *data)
-{
-	size_t 					size;
-
-	size = pow(data->fract->grid_size, 3) * 8;
-	if (!(data->vertexpos = (float3 *)malloc(size * sizeof(float3))))
-		error(MALLOC_FAIL_ERR, data);
-	if (!(data->vertexval = (float *)malloc(size * sizeof(float))))
-		error(MALLOC_FAIL_ERR, data);
-}
-
 void						init_grid(t_data *data)
 {
 	t_fract 				*f;
@@ -1,5 +1,12 @@
 #include <lib_complex.h>
 
+// Keep a * b + c as two roundings: the SIMD Julia lanes must match these.
+#if defined(__clang__)
+# pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+# pragma GCC optimize ("fp-contract=off")
+#endif
+
 TYPE			cl_creal(const cl_complex n)
 {
 	return(n.x);
@@ -121,7 +128,44 @@ cl_quat			cl_quat_mult(cl_quat q1, cl_quat q2)
 	res.x = (q1.x * q2.x) - (q1.y * q2.y) - (q1.z * q2.z) - (q1.w * q2.w);
 	res.y = (q1.x * q2.y) + (q1.y * q2.x) + (q1.z * q2.w) - (q1.w * q2.z);
 	res.z = (q1.x * q2.z) + (q1.z * q2.x) + (q1.w * q2.y) - (q1.y * q2.w);
-	res.w = (q1.x * q1.w) + (q1.w * q2.x) + (q1.y * q2.z) - (q1.z * q2.y);
+	res.w = (q1.x * q2.w) + (q1.w * q2.x) + (q1.y * q2.z) - (q1.z * q2.y);
+	return res;
+}
+
+/*
+** q * q: the cross product of the vector part with itself vanishes, which
+** leaves (x² - y² - z² - w², 2xy, 2xz, 2xw) — 7 multiplies instead of 16.
+*/
+
+cl_quat			cl_quat_sqr(cl_quat q)
+{
+	cl_quat 	res;
+	TYPE		x2;
+
+	x2 = q.x + q.x;
+	res.x = (q.x * q.x) - (q.y * q.y) - (q.z * q.z) - (q.w * q.w);
+	res.y = x2 * q.y;
+	res.z = x2 * q.z;
+	res.w = x2 * q.w;
+	return res;
+}
+
+/*
+** One Julia step: returns q² + c and stores its squared modulus in
+** mod_squared, the two values the escape test needs.
+*/
+
+cl_quat			cl_quat_sqr_add(cl_quat q, cl_quat c, TYPE *mod_squared)
+{
+	cl_quat 	res;
+	TYPE		x2;
+
+	x2 = q.x + q.x;
+	res.x = (q.x * q.x) - (q.y * q.y) - (q.z * q.z) - (q.w * q.w) + c.x;
+	res.y = x2 * q.y + c.y;
+	res.z = x2 * q.z + c.z;
+	res.w = x2 * q.w + c.w;
+	*mod_squared = res.x * res.x + res.y * res.y + res.z * res.z + res.w * res.w;
 	return res;
 }
 
@@ -161,3 +205,151 @@ TYPE 			cl_quat_mod_squared(cl_quat q)
 {
 	return (q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
 }
+
+// Exact equality, component by component
+int 			cl_quat_equal(cl_quat q1, cl_quat q2)
+{
+	return (q1.x == q2.x && q1.y == q2.y && q1.z == q2.z && q1.w == q2.w);
+}
+
+/*
+** Interval arithmetic. Each bound is the float operation applied to the
+** right ends of the operands, in the order cl_quat_sqr_add evaluates it.
+** Rounding to nearest is monotone, so the bounds hold the float result of
+** every point of the operands, not only the exact one: a box proven to
+** escape or stay bounded gets the same answer from the point sampler.
+*/
+
+cl_interval		cl_interval_make(TYPE a, TYPE b)
+{
+	cl_interval	res;
+
+	res.lo = (a < b) ? a : b;
+	res.hi = (a < b) ? b : a;
+	return res;
+}
+
+cl_interval		cl_interval_sum(cl_interval a, cl_interval b)
+{
+	cl_interval	res;
+
+	res.lo = a.lo + b.lo;
+	res.hi = a.hi + b.hi;
+	return res;
+}
+
+cl_interval		cl_interval_sub(cl_interval a, cl_interval b)
+{
+	cl_interval	res;
+
+	res.lo = a.lo - b.hi;
+	res.hi = a.hi - b.lo;
+	return res;
+}
+
+cl_interval		cl_interval_mult(cl_interval a, cl_interval b)
+{
+	const TYPE	p[4] = {a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi};
+	cl_interval	res;
+
+	res.lo = p[0];
+	res.hi = p[0];
+	for (int i = 1; i < 4; i++)
+	{
+		res.lo = (p[i] < res.lo) ? p[i] : res.lo;
+		res.hi = (p[i] > res.hi) ? p[i] : res.hi;
+	}
+	return res;
+}
+
+/*
+** a * a, tighter than cl_interval_mult(a, a): both factors are the same
+** number, so the square of an interval around 0 starts at 0.
+*/
+
+cl_interval		cl_interval_sqr(cl_interval a)
+{
+	cl_interval	res;
+	TYPE		lo2;
+	TYPE		hi2;
+
+	lo2 = a.lo * a.lo;
+	hi2 = a.hi * a.hi;
+	if (a.lo >= 0)
+		return cl_interval_make(lo2, hi2);
+	if (a.hi <= 0)
+		return cl_interval_make(hi2, lo2);
+	res.lo = 0;
+	res.hi = (lo2 > hi2) ? lo2 : hi2;
+	return res;
+}
+
+cl_iquat		cl_iquat_make(cl_quat lo, cl_quat hi)
+{
+	cl_iquat	res;
+
+	res.x = cl_interval_make(lo.x, hi.x);
+	res.y = cl_interval_make(lo.y, hi.y);
+	res.z = cl_interval_make(lo.z, hi.z);
+	res.w = cl_interval_make(lo.w, hi.w);
+	return res;
+}
+
+cl_iquat		cl_iquat_mult(cl_iquat q1, cl_iquat q2)
+{
+	cl_iquat	res;
+
+	res.x = cl_interval_sub(cl_interval_sub(cl_interval_sub(cl_interval_mult(q1.x, q2.x),
+		cl_interval_mult(q1.y, q2.y)), cl_interval_mult(q1.z, q2.z)),
+		cl_interval_mult(q1.w, q2.w));
+	res.y = cl_interval_sub(cl_interval_sum(cl_interval_sum(cl_interval_mult(q1.x, q2.y),
+		cl_interval_mult(q1.y, q2.x)), cl_interval_mult(q1.z, q2.w)),
+		cl_interval_mult(q1.w, q2.z));
+	res.z = cl_interval_sub(cl_interval_sum(cl_interval_sum(cl_interval_mult(q1.x, q2.z),
+		cl_interval_mult(q1.z, q2.x)), cl_interval_mult(q1.w, q2.y)),
+		cl_interval_mult(q1.y, q2.w));
+	res.w = cl_interval_sub(cl_interval_sum(cl_interval_sum(cl_interval_mult(q1.x, q2.w),
+		cl_interval_mult(q1.w, q2.x)), cl_interval_mult(q1.y, q2.z)),
+		cl_interval_mult(q1.z, q2.y));
+	return res;
+}
+
+cl_iquat		cl_iquat_sum(cl_iquat q1, cl_iquat q2)
+{
+	cl_iquat	res;
+
+	res.x = cl_interval_sum(q1.x, q2.x);
+	res.y = cl_interval_sum(q1.y, q2.y);
+	res.z = cl_interval_sum(q1.z, q2.z);
+	res.w = cl_interval_sum(q1.w, q2.w);
+	return res;
+}
+
+cl_interval		cl_iquat_mod_squared(cl_iquat q)
+{
+	return cl_interval_sum(cl_interval_sum(cl_interval_sum(cl_interval_sqr(q.x),
+		cl_interval_sqr(q.y)), cl_interval_sqr(q.z)), cl_interval_sqr(q.w));
+}
+
+/*
+** cl_quat_sqr_add over a box: q² + c for every q of it, and the bounds of
+** their squared moduli.
+*/
+
+cl_iquat		cl_iquat_sqr_add(cl_iquat q, cl_quat c, cl_interval *mod_squared)
+{
+	cl_iquat	res;
+	cl_interval	x2;
+	cl_interval	cx;
+
+	x2 = cl_interval_sum(q.x, q.x);
+	cx = cl_interval_make(c.x, c.x);
+	res.x = cl_interval_sum(cl_interval_sub(cl_interval_sub(cl_interval_sub(
+		cl_interval_sqr(q.x), cl_interval_sqr(q.y)), cl_interval_sqr(q.z)),
+		cl_interval_sqr(q.w)), cx);
+	res.y = cl_interval_sum(cl_interval_mult(x2, q.y), cl_interval_make(c.y, c.y));
+	res.z = cl_interval_sum(cl_interval_mult(x2, q.z), cl_interval_make(c.z, c.z));
+	res.w = cl_interval_sum(cl_interval_mult(x2, q.w), cl_interval_make(c.w, c.w));
+	*mod_squared = cl_iquat_mod_squared(res);
+	return res;
+}
@@ -1,6 +1,6 @@
 #include "morphosis.h"
 
-static t_data 						*get_args(int argv, char **argc)
+static t_data 						*get_params(int argv, char **argc, t_opts *opts)
 {
 	t_data					*data;
 	float 					s_size;
@@ -41,8 +41,12 @@ static t_data 						*get_args(int argv, char **argc)
 	if ((s_size = (float)strtod(argc[1], NULL)) < 0.00001 || s_size > 1)
 		s_size = s_size_warning(s_size);
 
-	printf(ASK_ITER);
-	fscanf(stdin, "%d", &iter);
+	iter = opts->iter;
+	if (!iter)
+	{
+		printf(ASK_ITER);
+		fscanf(stdin, "%d", &iter);
+	}
 
 	q.x = (float)strtod(argc[2], NULL);
 	q.y = (float)strtod(argc[3], NULL);
@@ -56,23 +60,35 @@ static t_data 						*get_args(int argv, char **argc)
 	return data;
 }
 
+static t_data 						*get_args(int argv, char **argc)
+{
+	t_data					*data;
+	t_opts					opts;
+
+	argv = parse_options(argv, argc, &opts);
+	data = get_params(argv, argc, &opts);
+	data->opts = opts;
+	data->fract->julia->field = opts.field;
+	data->fract->julia->periodicity = opts.periodicity;
+	if (opts.iter)
+		data->fract->julia->max_iter = opts.iter;
+	return data;
+}
+
 int 						main(int argv, char **argc)
 {
 	t_data 					*data;
 
 	data = get_args(argv, argc);
-	calculate_point_cloud(data);
-	gl_retrieve_tris(data);
-	clean_calcs(data);
-
-	run_graphics(data->gl, data->fract->p1, data->fract->p0);
-	if (data->gl->export)
+#ifndef CONF_NO_GL
+	if (!data->opts.headless && !data->opts.stream_out)
 	{
-		printf("\nEXPORTING----\n");
-		export_obj(data);
-		printf("DONE\n");
+		run_viewer(data);
+		clean_up(data);
+		return 0;
 	}
-
+#endif
+	run_headless(data);
 	clean_up(data);
 	return 0;
 }
@@ -24,6 +24,8 @@
 #include <string.h>
 #include <assert.h>
 #include <math.h>
+#include <limits.h>
+#include <pthread.h>
 
 #ifndef CONF_NO_GL
 #include <GL/glew.h>
@@ -201,6 +203,33 @@ static int add__(void **_v, int *_c, int *_m, size_t _s)
     else return -1;
 }
 
+/* Makes room for n more elements of size _s in one step and returns the */
+/* index of the first, or -1 on failure.                                 */
+
+static int addn__(void **_v, int *_c, int *_m, int n, size_t _s)
+{
+    int   m = (*_m > 0) ? *_m : 2;
+    int   c = *_c;
+    void *v;
+
+    if (n < 0 || n > INT_MAX - c)
+        return -1;
+
+    if (c + n > *_m)
+    {
+        while (m < c + n)
+            m = (m > INT_MAX / 2) ? c + n : m * 2;
+
+        if (!(v = realloc(*_v, _s * m)))
+            return -1;
+
+        *_v = v;
+        *_m = m;
+    }
+    *_c += n;
+    return c;
+}
+
 static int add_v(void)
 {
     return add__((void **) &_vv, &_vc, &_vm, sizeof (struct vec3));
@@ -1129,6 +1158,64 @@ int obj_add_poly(obj *O, int si)
     return pi;
 }
 
+/* Appends n vertices with positions v[0], v[stride], ... in one step and */
+/* returns the index of the first, or -1 on failure. Every other vertex   */
+/* attribute starts at zero, as with obj_add_vert.                       */
+
+int obj_add_verts(obj *O, int n, const float *v, int stride)
+{
+    int vi;
+    int i;
+
+    assert(O);
+
+    if ((vi = addn__((void **) &O->vv, &O->vc, &O->vm, n, sizeof (struct obj_vert))) >= 0)
+    {
+        memset(O->vv + vi, 0, n * sizeof (struct obj_vert));
+
+        for (i = 0; i < n; ++i, v += stride)
+        {
+            O->vv[vi + i].v[0] = v[0];
+            O->vv[vi + i].v[1] = v[1];
+            O->vv[vi + i].v[2] = v[2];
+        }
+        invalidate(O);
+    }
+    return vi;
+}
+
+/* Appends n triangles to surface si in one step, their corners the 3n    */
+/* vertex indices of vi offset by base, and returns the index of the      */
+/* first, or -1 on failure.                                               */
+
+int obj_add_polys(obj *O, int si, int n, const unsigned int *vi, int base)
+{
+    struct obj_poly *pp;
+    int pi;
+    int i;
+
+    assert_surf(O, si);
+
+    if ((pi = addn__((void **) &O->sv[si].pv,
+                               &O->sv[si].pc,
+                               &O->sv[si].pm, n, sizeof (struct obj_poly))) >= 0)
+    {
+        pp = O->sv[si].pv + pi;
+
+        if (base == 0 && sizeof (index_t) == sizeof (unsigned int))
+            memcpy(pp, vi, 3 * (size_t) n * sizeof (index_t));
+        else
+            for (i = 0; i < n; ++i, vi += 3)
+            {
+                pp[i].vi[0] = (index_t) (vi[0] + base);
+                pp[i].vi[1] = (index_t) (vi[1] + base);
+                pp[i].vi[2] = (index_t) (vi[2] + base);
+            }
+        invalidate(O);
+    }
+    return pi;
+}
+
 int obj_add_line(obj *O, int si)
 {
     int li;
@@ -1469,6 +1556,24 @@ void obj_set_line(obj *O, int si, int li, const int vi[2])
     O->sv[si].lv[li].vi[1] = (index_t) vi[1];
 }
 
+/* Replaces every triangle of surface si with the 3 * obj_num_poly(O, si) */
+/* vertex indices of vi, in that order.                                   */
+
+void obj_set_polys(obj *O, int si, const unsigned int *vi)
+{
+    int i;
+
+    assert_surf(O, si);
+
+    for (i = 0; i < O->sv[si].pc; ++i, vi += 3)
+    {
+        O->sv[si].pv[i].vi[0] = (index_t) vi[0];
+        O->sv[si].pv[i].vi[1] = (index_t) vi[1];
+        O->sv[si].pv[i].vi[2] = (index_t) vi[2];
+    }
+    invalidate(O);
+}
+
 void obj_set_surf(obj *O, int si, int mi)
 {
     assert_surf(O, si);
@@ -1586,6 +1691,38 @@ void obj_get_poly(const obj *O, int si, int pi, int *vi)
     vi[2] = (int) O->sv[si].pv[pi].vi[2];
 }
 
+/* Copies the positions of all vertices to v[0], v[stride], ...          */
+
+void obj_get_verts(const obj *O, float *v, int stride)
+{
+    int i;
+
+    assert(O);
+
+    for (i = 0; i < O->vc; ++i, v += stride)
+    {
+        v[0] = O->vv[i].v[0];
+        v[1] = O->vv[i].v[1];
+        v[2] = O->vv[i].v[2];
+    }
+}
+
+/* Copies the vertex indices of all triangles of surface si to vi.        */
+
+void obj_get_polys(const obj *O, int si, unsigned int *vi)
+{
+    int i;
+
+    assert_surf(O, si);
+
+    for (i = 0; i < O->sv[si].pc; ++i, vi += 3)
+    {
+        vi[0] = (unsigned int) O->sv[si].pv[i].vi[0];
+        vi[1] = (unsigned int) O->sv[si].pv[i].vi[1];
+        vi[2] = (unsigned int) O->sv[si].pv[i].vi[2];
+    }
+}
+
 void obj_get_line(const obj *O, int si, int li, int *vi)
 {
     assert_line(O, si, li);
@@ -1881,33 +2018,292 @@ void obj_swp_vert(obj *O, int vi, int vj)
     }
 }
 
-void obj_uniq(obj *O, float eps, float dot, int verbose)
+/* Runs fn on each of the jc jobs of jv, js bytes apart: the first on the */
+/* calling thread, the others on threads of their own when tc allows.     */
+/* Returns 0 when a job returned NULL.                                    */
+
+static int obj_run(void *(*fn)(void *), void *jv, size_t js, int jc, int tc)
+{
+    pthread_t *tv = (tc > 1 && jc > 1) ? (pthread_t *) malloc(jc * sizeof (pthread_t)) : NULL;
+    char *j = (char *) jv;
+    void *r;
+    int ok = 1;
+    int tn = 0;
+    int ji;
+
+    if (tv)
+        for (ji = 1; ji < jc; ++ji, ++tn)
+            if (pthread_create(tv + ji, NULL, fn, j + ji * js))
+                break;
+
+    if (!fn(j)) ok = 0;
+
+    for (ji = 1; ji <= tn; ++ji)
+        if (pthread_join(tv[ji], &r) || !r) ok = 0;
+
+    for (ji = tn + 1; ji < jc; ++ji)
+        if (!fn(j + ji * js)) ok = 0;
+
+    free(tv);
+    return ok;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Vertex welding                                                             */
+
+/* Vertices are hashed on a grid of cells 2 eps wide, so two vertices that */
+/* obj_cmp_vert may match are always in the same cell or in neighbouring   */
+/* ones, whatever the rounding of their cell, and only on the side of the  */
+/* cell a vertex is nearest to: a vertex in the lower three quarters of    */
+/* its cell along an axis looks at the cell below, one in the upper three  */
+/* quarters at the cell above. Each slot of the hash lists its vertices in */
+/* index order.                                                            */
+
+struct obj_weld
+{
+    obj   *O;
+    float  eps;
+    float  dot;
+    int    lo;
+    int    hi;
+
+    long long *cell;    /* 3 cell coordinates per vertex */
+    unsigned char *side;/* neighbours to look at, 2 bits per axis */
+    int       *slot;    /* hash slot per vertex          */
+    int       *head;    /* first list entry per slot     */
+    int       *list;    /* vertex indices by slot        */
+    int       *cand;    /* lowest earlier match or -1    */
+    int        mask;
+};
+
+static int weld_hash(long long x, long long y, long long z, int mask)
+{
+    unsigned long long h = (unsigned long long) x * 0x9E3779B97F4A7C15ull
+                         ^ (unsigned long long) y * 0xC2B2AE3D27D4EB4Full
+                         ^ (unsigned long long) z * 0x165667B19E3779F9ull;
+
+    return (int) ((h ^ (h >> 29)) & (unsigned long long) mask);
+}
+
+static void *weld_cells(void *arg)
+{
+    struct obj_weld *W = (struct obj_weld *) arg;
+    const double     k = 1.0 / (2.0 * W->eps);
+    int side[3];
+    int vi;
+    int a;
+
+    for (vi = W->lo; vi < W->hi; ++vi)
+    {
+        long long *c = W->cell + 3 * vi;
+
+        for (a = 0; a < 3; ++a)
+        {
+            double q = floor(W->O->vv[vi].v[a] * k);
+
+            double f = W->O->vv[vi].v[a] * k - q;
+
+            c[a] = (q != q)    ? 0 :
+                   (q < -1e15) ? -1000000000000000ll :
+                   (q >  1e15) ?  1000000000000000ll : (long long) q;
+
+            side[a] = (f < 0.75) | (f > 0.25) << 1;
+        }
+        W->side[vi] = (unsigned char) (side[0] | side[1] << 2 | side[2] << 4);
+        W->slot[vi] = weld_hash(c[0], c[1], c[2], W->mask);
+    }
+    return W;
+}
+
+/* Lowest vertex before vi that matches it, among all of them, or among */
+/* those still kept when keep is not NULL. -1 when there is none.       */
+
+static int weld_match(struct obj_weld *W, int vi, const int *keep)
+{
+    const long long *c = W->cell + 3 * vi;
+    const int        m = W->side[vi];
+    int best = -1;
+    int dx;
+    int dy;
+    int dz;
+    int ii;
+
+    for (dz = -1; dz <= 1; ++dz)
+        for (dy = -1; dy <= 1; ++dy)
+            for (dx = -1; dx <= 1; ++dx)
+            {
+                int s;
+
+                if ((dx && !(m >> (dx > 0)      & 1)) ||
+                    (dy && !(m >> (2 + (dy > 0)) & 1)) ||
+                    (dz && !(m >> (4 + (dz > 0)) & 1)))
+                    continue;
+
+                s = weld_hash(c[0] + dx, c[1] + dy, c[2] + dz, W->mask);
+
+                for (ii = W->head[s]; ii < W->head[s + 1]; ++ii)
+                {
+                    int vj = W->list[ii];
+
+                    if (vj >= vi || (best >= 0 && vj >= best))
+                        break;
+                    if ((!keep || keep[vj] >= 0) &&
+                        obj_cmp_vert(W->O, vi, vj, W->eps, W->dot))
+                    {
+                        best = vj;
+                        break;
+                    }
+                }
+            }
+    return best;
+}
+
+static void *weld_cands(void *arg)
 {
-    int vc = O->vc;
+    struct obj_weld *W = (struct obj_weld *) arg;
     int vi;
-    int vj;
-    int di;
 
-    /* Merge all vertices within epsilon of one another. */
+    for (vi = W->lo; vi < W->hi; ++vi)
+        W->cand[vi] = weld_match(W, vi, NULL);
+    return W;
+}
+
+/* Merges every vertex into the first kept vertex that matches it, as a */
+/* scan of the vertices in order would, then compacts the vertices and  */
+/* renumbers the polygons and lines in a single pass. Matches are found */
+/* on tc threads; only a vertex whose match was itself merged is looked */
+/* at again, against the kept vertices.                                 */
 
-    for (vi = 0; vi < O->vc; vi += di)
+void obj_uniq(obj *O, float eps, float dot, int verbose, int tc)
+{
+    struct obj_weld  W;
+    struct obj_weld *jv;
+
+    const int vc = O->vc;
+
+    int *keep;
+    int  kc = 0;
+    int  sc = 1;
+    int  si;
+    int  vi;
+    int  ii;
+    int  ji;
+
+    assert(O);
+
+    if (!(eps > 0) || vc < 2)
+        return;
+    if (tc < 1)
+        tc = 1;
+
+    while (sc < 2 * vc)
+        sc *= 2;
+
+    W.O    = O;
+    W.eps  = eps;
+    W.dot  = dot;
+    W.mask = sc - 1;
+    W.cell = (long long *) malloc(3 * vc * sizeof (long long));
+    W.slot = (int *) malloc(vc * sizeof (int));
+    W.side = (unsigned char *) malloc(vc);
+    W.head = (int *) calloc(sc + 1, sizeof (int));
+    W.list = (int *) malloc(vc * sizeof (int));
+    W.cand = (int *) malloc(vc * sizeof (int));
+    keep   = (int *) malloc(vc * sizeof (int));
+    jv     = (struct obj_weld *) malloc(tc * sizeof (struct obj_weld));
+
+    if (W.cell && W.side && W.slot && W.head && W.list && W.cand && keep && jv)
     {
-        di = 1;
+        /* Cells and slots of all vertices, on tc threads. */
+
+        for (ji = 0; ji < tc; ++ji)
+        {
+            jv[ji]    = W;
+            jv[ji].lo = (int) ((long long) vc *  ji      / tc);
+            jv[ji].hi = (int) ((long long) vc * (ji + 1) / tc);
+        }
+        obj_run(weld_cells, jv, sizeof (struct obj_weld), tc, tc);
+
+        /* Sort the vertices by slot, keeping index order within a slot. */
+
+        for (vi = 0; vi < vc; ++vi)
+            W.head[W.slot[vi] + 1]++;
+        for (ii = 0; ii < sc; ++ii)
+            W.head[ii + 1] += W.head[ii];
+        for (vi = 0; vi < vc; ++vi)
+            W.list[W.head[W.slot[vi]]++] = vi;
+        for (ii = sc; ii > 0; --ii)
+            W.head[ii] = W.head[ii - 1];
+        W.head[0] = 0;
+
+        /* Lowest earlier match of each vertex, on tc threads. */
+
+        for (ji = 0; ji < tc; ++ji)
+        {
+            jv[ji].head = W.head;
+            jv[ji].list = W.list;
+        }
+        obj_run(weld_cands, jv, sizeof (struct obj_weld), tc, tc);
+
+        /* Resolve in order: keep[vi] is the new index of a kept vertex, */
+        /* -1 - its target for a merged one.                             */
 
-        for (vj = 0; vj < vi; ++vj)
+        for (vi = 0; vi < vc; ++vi)
         {
-            if (obj_cmp_vert(O, vi, vj, eps, dot))
+            int vj = W.cand[vi];
+
+            if (vj >= 0 && keep[vj] < 0)
+                vj = weld_match(&W, vi, keep);
+
+            if (vj >= 0)
             {
-                if (verbose) printf("%d %d\n", vi, vc--);
+                keep[vi] = -1 - keep[vj];
+                if (verbose) printf("%d %d\n", vi, vj);
+            }
+            else
+                keep[vi] = kc++;
+        }
 
-                obj_swp_vert(O, vi, vj);
-                obj_del_vert(O, vi);
+        /* Compact the kept vertices and renumber every reference through */
+        /* the table.                                                     */
 
-                di = 0;
-                break;
+        for (vi = 0; vi < vc; ++vi)
+            if (keep[vi] < 0)
+                keep[vi] = -1 - keep[vi];
+            else
+                O->vv[keep[vi]] = O->vv[vi];
+
+        for (si = 0; si < O->sc; ++si)
+        {
+            for (ii = 0; ii < O->sv[si].pc; ++ii)
+            {
+                index_t *i = O->sv[si].pv[ii].vi;
+
+                i[0] = keep[i[0]];
+                i[1] = keep[i[1]];
+                i[2] = keep[i[2]];
+            }
+            for (ii = 0; ii < O->sv[si].lc; ++ii)
+            {
+                index_t *i = O->sv[si].lv[ii].vi;
+
+                i[0] = keep[i[0]];
+                i[1] = keep[i[1]];
             }
         }
+        O->vc = kc;
+
+        invalidate(O);
     }
+
+    free(jv);
+    free(keep);
+    free(W.cand);
+    free(W.list);
+    free(W.head);
+    free(W.slot);
+    free(W.side);
+    free(W.cell);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -2082,35 +2478,58 @@ void obj_sort(obj *O, int qc)
     free(vv);
 }
 
+/* Count the misses of a FIFO cache of qc vertices over the index list iv. */
+
+static int obj_acmr_miss(const unsigned int *iv, int ic, int *vs, int vc, int qc)
+{
+    int qs = 1;
+    int nn = 0;
+
+    int vi;
+    int ii;
+
+    for (vi = 0; vi < vc; ++vi)
+        vs[vi] = -qc;
+
+    for (ii = 0; ii < ic; ++ii)
+        if (qs - vs[iv[ii]] >= qc) { vs[iv[ii]] = qs++; nn++; }
+
+    return nn;
+}
+
+float obj_acmr_index(const unsigned int *iv, int ic, int vc, int qc)
+{
+    int *vs = (int *) malloc(vc * sizeof (int));
+    int  nn = 0;
+
+    if (vs && ic)
+        nn = obj_acmr_miss(iv, ic, vs, vc, qc);
+
+    free(vs);
+
+    return ic ? 3.0f * (float) nn / (float) ic : 0.0f;
+}
+
 float obj_acmr(obj *O, int qc)
 {
     int *vs = (int *) malloc(O->vc * sizeof (int));
-    int  qs = 1;
 
     int si;
-    int vi;
-    int pi;
 
     int nn = 0;
     int dd = 0;
 
+    /* Polygons are index_t triples, so each surface is one index list. */
+
     for (si = 0; si < O->sc; ++si)
     {
-        for (vi = 0; vi < O->vc; ++vi)
-            vs[vi] = -qc;
-
-        for (pi = 0; pi < O->sv[si].pc; ++pi)
-        {
-            const index_t *i = O->sv[si].pv[pi].vi;
-
-            if (qs - vs[i[0]] >= qc) { vs[i[0]] = qs++; nn++; }
-            if (qs - vs[i[1]] >= qc) { vs[i[1]] = qs++; nn++; }
-            if (qs - vs[i[2]] >= qc) { vs[i[2]] = qs++; nn++; }
-
-            dd++;
-        }
+        nn += obj_acmr_miss((const unsigned int *) O->sv[si].pv,
+                            3 * O->sv[si].pc, vs, O->vc, qc);
+        dd += O->sv[si].pc;
     }
 
+    free(vs);
+
     return (float) nn / (float) dd;
 }
 
@@ -2351,87 +2770,308 @@ static void obj_write_mtl(const obj *O, const char *mtl)
     fclose(fout);
 }
 
-static void obj_write_obj(const obj *O, const char *obj,
-                                        const char *mtl, int prec)
+/*----------------------------------------------------------------------------*/
+/* Fast OBJ output                                                            */
+
+/* Vertices, texture coordinates, normals and polygons are formatted without */
+/* printf, in blocks of OBJ_WRITE_BLOCK lines. Each round hands one block to */
+/* each thread, which formats it into a buffer of its own, and the buffers   */
+/* are then written in order, so the file does not depend on the thread      */
+/* count and never has to be held whole.                                     */
+
+#define OBJ_WRITE_BLOCK 65536
+#define OBJ_WRITE_LINE  256
+
+enum { OBJ_SEC_V, OBJ_SEC_T, OBJ_SEC_N, OBJ_SEC_P, OBJ_SEC_L };
+
+struct obj_job
 {
-    FILE *fout;
+    const obj *O;
+
+    int sec;
+    int si;
+    int lo;
+    int hi;
+    int prec;
+    int has_t;
+    int has_n;
+
+    char  *buf;
+    size_t len;
+    size_t cap;
+};
+
+static const double   pow10d[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8 };
+static const unsigned pow10u[] = { 1u, 10u, 100u, 1000u, 10000u, 100000u,
+                                   1000000u, 10000000u, 100000000u };
+
+static char *put_uint(char *p, unsigned long long u)
+{
+    char t[24];
+    int  n = 0;
+
+    do t[n++] = (char) ('0' + u % 10); while ((u /= 10));
+    while (n) *p++ = t[--n];
+    return p;
+}
+
+/* Same text as printf("%.*f", prec, f). A float scaled by at most 10^8 is */
+/* exact in a double, so rounding it once to an integer rounds the way     */
+/* printf does. Values out of that range go through printf.                */
+
+static char *put_float(char *p, float f, int prec)
+{
+    unsigned long long u;
+    unsigned long long d;
+    int i;
+
+    if (prec < 0 || prec > 8 || !(fabsf(f) < 1e9f))
+        return p + sprintf(p, "%.*f", prec, f);
+
+    if (signbit(f)) *p++ = '-';
+
+    u = (unsigned long long) nearbyint(fabs((double) f) * pow10d[prec]);
+    d = u % pow10u[prec];
+    p = put_uint(p, u / pow10u[prec]);
+
+    if (prec > 0)
+    {
+        *p++ = '.';
+        for (i = prec - 1; i >= 0; --i, d /= 10)
+            p[i] = (char) ('0' + d % 10);
+        p += prec;
+    }
+    return p;
+}
 
-    if ((fout = fopen(obj, "w")))
+/* One polygon or line corner: v, v/t, v//n or v/t/n. */
+
+static char *put_corner(char *p, int vi, int has_t, int has_n)
+{
+    *p++ = ' ';
+    p = put_uint(p, (unsigned) vi);
+
+    if (has_t || has_n)
+    {
+        *p++ = '/';
+        if (has_t) p = put_uint(p, (unsigned) vi);
+    }
+    if (has_n)
     {
-        char formv[256];
-        char formt[256];
-        char formn[256];
+        *p++ = '/';
+        p = put_uint(p, (unsigned) vi);
+    }
+    return p;
+}
 
-        int si;
-        int vi;
-        int pi;
-        int li;
-
-        if (mtl) fprintf(fout, "mtllib %s\n", mtl);
-
-        /* Store all vertex data. */
-
-        sprintf(formv, "v %%.%df %%.%df %%.%df\n",  prec, prec, prec);
-        sprintf(formt, "vt %%.%df %%.%df\n",        prec, prec);
-        sprintf(formn, "vn %%.%df %%.%df %%.%df\n", prec, prec, prec);
-
-        for (vi = 0; vi < O->vc; ++vi)
-            fprintf(fout, formv, O->vv[vi].v[0],
-                                 O->vv[vi].v[1],
-                                 O->vv[vi].v[2]);
-        for (vi = 0; vi < O->vc; ++vi)
-            fprintf(fout, formt, O->vv[vi].t[0],
-                                 O->vv[vi].t[1]);
-        for (vi = 0; vi < O->vc; ++vi)
-            fprintf(fout, formn, O->vv[vi].n[0],
-                                 O->vv[vi].n[1],
-                                 O->vv[vi].n[2]);
+static void *obj_write_job(void *arg)
+{
+    struct obj_job  *J = (struct obj_job *) arg;
+    const obj       *O = J->O;
+    char *p;
+    int   i;
 
-        for (si = 0; si < O->sc; ++si)
+    for (i = J->lo; i < J->hi; ++i)
+    {
+        /* Keep room for the longest line. */
+
+        if (J->cap - J->len < OBJ_WRITE_LINE)
         {
-            int mi = O->sv[si].mi;
+            size_t m = J->cap ? J->cap * 2 : (size_t) OBJ_WRITE_BLOCK * 64;
 
-            /* Store the surface's material reference */
+            if (!(p = (char *) realloc(J->buf, m)))
+                return NULL;
 
-            if (0 <= mi && mi < O->mc && O->mv[mi].name)
-                fprintf(fout, "usemtl %s\n", O->mv[O->sv[si].mi].name);
-            else
-                fprintf(fout, "usemtl default\n");
+            J->buf = p;
+            J->cap = m;
+        }
+        p = J->buf + J->len;
 
-            /* Store all polygon definitions. */
+        switch (J->sec)
+        {
+        case OBJ_SEC_V:
+            *p++ = 'v';
+            *p++ = ' '; p = put_float(p, O->vv[i].v[0], J->prec);
+            *p++ = ' '; p = put_float(p, O->vv[i].v[1], J->prec);
+            *p++ = ' '; p = put_float(p, O->vv[i].v[2], J->prec);
+            break;
+        case OBJ_SEC_T:
+            *p++ = 'v';
+            *p++ = 't';
+            *p++ = ' '; p = put_float(p, O->vv[i].t[0], J->prec);
+            *p++ = ' '; p = put_float(p, O->vv[i].t[1], J->prec);
+            break;
+        case OBJ_SEC_N:
+            *p++ = 'v';
+            *p++ = 'n';
+            *p++ = ' '; p = put_float(p, O->vv[i].n[0], J->prec);
+            *p++ = ' '; p = put_float(p, O->vv[i].n[1], J->prec);
+            *p++ = ' '; p = put_float(p, O->vv[i].n[2], J->prec);
+            break;
+        case OBJ_SEC_P:
+            *p++ = 'f';
+            p = put_corner(p, O->sv[J->si].pv[i].vi[0] + 1, J->has_t, J->has_n);
+            p = put_corner(p, O->sv[J->si].pv[i].vi[1] + 1, J->has_t, J->has_n);
+            p = put_corner(p, O->sv[J->si].pv[i].vi[2] + 1, J->has_t, J->has_n);
+            break;
+        case OBJ_SEC_L:
+            *p++ = 'l';
+            p = put_corner(p, O->sv[J->si].lv[i].vi[0] + 1, J->has_t, 0);
+            p = put_corner(p, O->sv[J->si].lv[i].vi[1] + 1, J->has_t, 0);
+            break;
+        }
+        *p++ = '\n';
 
-            for (pi = 0; pi < O->sv[si].pc; pi++)
-            {
-                int vi0 = O->sv[si].pv[pi].vi[0] + 1;
-                int vi1 = O->sv[si].pv[pi].vi[1] + 1;
-                int vi2 = O->sv[si].pv[pi].vi[2] + 1;
+        J->len = (size_t) (p - J->buf);
+    }
+    return J;
+}
 
-                fprintf(fout, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", vi0, vi0, vi0,
-                                                                vi1, vi1, vi1,
-                                                                vi2, vi2, vi2);
-            }
+/* Texture coordinates are only written when one is not zero, and normals */
+/* when one is a finite, non-zero vector: otherwise polygons only refer to */
+/* vertex positions.                                                       */
+
+static void obj_used_attr(const obj *O, int *has_t, int *has_n)
+{
+    int vi;
+
+    *has_t = 0;
+    *has_n = 0;
+
+    for (vi = 0; vi < O->vc; ++vi)
+    {
+        const float *t = O->vv[vi].t;
+        const float *n = O->vv[vi].n;
+
+        if (t[0] != 0 || t[1] != 0)
+            *has_t = 1;
+        if (isfinite(n[0]) && isfinite(n[1]) && isfinite(n[2]) &&
+            (n[0] != 0 || n[1] != 0 || n[2] != 0))
+            *has_n = 1;
+    }
+}
+
+/* Runs the queued jobs on up to tc threads, then writes their text in   */
+/* queue order. Returns 0 on failure.                                    */
+
+static int obj_write_round(FILE *fout, struct obj_job *jv, int jc, int tc)
+{
+    int ok;
+    int ji;
 
-            /* Store all line definitions. */
+    for (ji = 0; ji < jc; ++ji)
+        jv[ji].len = 0;
 
-            for (li = 0; li < O->sv[si].lc; li++)
+    ok = obj_run(obj_write_job, jv, sizeof (struct obj_job), jc, tc);
+
+    for (ji = 0; ok && ji < jc; ++ji)
+        if (jv[ji].len && fwrite(jv[ji].buf, 1, jv[ji].len, fout) != jv[ji].len)
+            ok = 0;
+
+    return ok;
+}
+
+static int obj_write_obj(const obj *O, const char *obj,
+                                       const char *mtl, int prec, int tc)
+{
+    struct obj_job *jv;
+    FILE *fout;
+
+    int has_t;
+    int has_n;
+    int jc = 0;
+    int ok = 1;
+    int si;
+    int sec;
+    int lo;
+    int hi;
+    int ji;
+
+    if (tc < 1) tc = 1;
+
+    if (!(fout = fopen(obj, "w")))
+        return 0;
+
+    if (!(jv = (struct obj_job *) calloc(tc, sizeof (struct obj_job))))
+    {
+        fclose(fout);
+        return 0;
+    }
+
+    if (mtl) fprintf(fout, "mtllib %s\n", mtl);
+
+    obj_used_attr(O, &has_t, &has_n);
+
+    /* Walk the sections in file order, cutting them into blocks, and */
+    /* flush a round whenever every thread has a block.               */
+
+    for (si = -1; ok && si < O->sc; ++si)
+        for (sec = (si < 0) ? OBJ_SEC_V : OBJ_SEC_P;
+             ok && sec <= ((si < 0) ? OBJ_SEC_N : OBJ_SEC_L); ++sec)
+        {
+            int c = (sec == OBJ_SEC_P) ? O->sv[si].pc :
+                    (sec == OBJ_SEC_L) ? O->sv[si].lc : O->vc;
+
+            if ((sec == OBJ_SEC_T && !has_t) || (sec == OBJ_SEC_N && !has_n))
+                continue;
+
+            /* Store the surface's material reference before its polygons. */
+
+            if (sec == OBJ_SEC_P)
             {
-                int vi0 = O->sv[si].lv[li].vi[0] + 1;
-                int vi1 = O->sv[si].lv[li].vi[1] + 1;
+                int mi = O->sv[si].mi;
+
+                ok = obj_write_round(fout, jv, jc, tc);
+                jc = 0;
 
-                fprintf(fout, "l %d/%d/%d %d/%d/%d\n", vi0, vi0, vi0,
-                                                       vi1, vi1, vi1);
+                if (0 <= mi && mi < O->mc && O->mv[mi].name)
+                    fprintf(fout, "usemtl %s\n", O->mv[mi].name);
+                else
+                    fprintf(fout, "usemtl default\n");
+            }
+
+            for (lo = 0; ok && lo < c; lo = hi)
+            {
+                hi = (c - lo > OBJ_WRITE_BLOCK) ? lo + OBJ_WRITE_BLOCK : c;
+
+                jv[jc].O     = O;
+                jv[jc].sec   = sec;
+                jv[jc].si    = si;
+                jv[jc].lo    = lo;
+                jv[jc].hi    = hi;
+                jv[jc].prec  = prec;
+                jv[jc].has_t = has_t;
+                jv[jc].has_n = has_n;
+
+                if (++jc == tc)
+                {
+                    ok = obj_write_round(fout, jv, jc, tc);
+                    jc = 0;
+                }
             }
         }
 
-        fclose(fout);
-    }
+    if (ok && jc)
+        ok = obj_write_round(fout, jv, jc, tc);
+
+    for (ji = 0; ji < tc; ++ji)
+        free(jv[ji].buf);
+    free(jv);
+
+    if (fclose(fout))
+        ok = 0;
+    return ok;
 }
 
-void obj_write(const obj *O, const char *obj, const char *mtl, int prec)
+int obj_write(const obj *O, const char *obj, const char *mtl, int prec, int tc)
 {
+    int ok = 1;
+
     assert(O);
 
-    if (obj) obj_write_obj(O, obj, mtl, prec);
+    if (obj) ok = obj_write_obj(O, obj, mtl, prec, tc);
     if (mtl) obj_write_mtl(O, mtl);
+
+    return ok;
 }
 
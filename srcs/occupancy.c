@@ -0,0 +1,156 @@
+#include "morphosis.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+# define OCCUPANCY_X86 1
+#endif
+
+typedef void				(*t_pack_fn)(const float *, size_t, uint64_t *, size_t);
+
+/*
+** Occupancy rows hold one bit per lattice point, set when its field value
+** is positive: 1.0 for the binary field, the distance to the surface for
+** the distance field. Rows carry a spare word so a window can always read
+** the bit after its last cell.
+*/
+
+size_t						occupancy_words(size_t n)
+{
+	return (n + 1 + 63) / 64 + 1;
+}
+
+static void					pack_scalar(const float *vals, size_t count, uint64_t *row,
+								size_t words)
+{
+	memset(row, 0, words * sizeof(uint64_t));
+	for (size_t x = 0; x < count; x++)
+		row[x >> 6] |= (uint64_t)(vals[x] > 0.0f) << (x & 63);
+}
+
+#ifdef OCCUPANCY_X86
+
+/*
+** 8 points per compare: the sign mask of the comparison is their 8 bits,
+** and groups of 8 never straddle a word.
+*/
+
+__attribute__((target("avx2")))
+static void					pack_avx2(const float *vals, size_t count, uint64_t *row,
+								size_t words)
+{
+	const __m256			zero = _mm256_setzero_ps();
+	__m256					gt;
+	size_t					x;
+
+	memset(row, 0, words * sizeof(uint64_t));
+	for (x = 0; x + 8 <= count; x += 8)
+	{
+		gt = _mm256_cmp_ps(_mm256_loadu_ps(vals + x), zero, _CMP_GT_OQ);
+		row[x >> 6] |= (uint64_t)_mm256_movemask_ps(gt) << (x & 63);
+	}
+	for (; x < count; x++)
+		row[x >> 6] |= (uint64_t)(vals[x] > 0.0f) << (x & 63);
+}
+
+#endif
+
+static t_pack_fn			g_pack_fn = NULL;
+static pthread_once_t		g_pack_once = PTHREAD_ONCE_INIT;
+
+static void					select_pack_fn(void)
+{
+	g_pack_fn = pack_scalar;
+#ifdef OCCUPANCY_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		g_pack_fn = pack_avx2;
+#endif
+}
+
+/*
+** Bits of the first count values into a row of words words. Every row of
+** every plane goes through here, so it is vectorised where the CPU allows.
+*/
+
+void						pack_row(const float *vals, size_t count, uint64_t *row, size_t words)
+{
+	pthread_once(&g_pack_once, select_pack_fn);
+	g_pack_fn(vals, count, row, words);
+}
+
+static uint64_t				reverse_word(uint64_t v)
+{
+	v = ((v >> 1) & 0x5555555555555555ull) | ((v & 0x5555555555555555ull) << 1);
+	v = ((v >> 2) & 0x3333333333333333ull) | ((v & 0x3333333333333333ull) << 2);
+	v = ((v >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((v & 0x0F0F0F0F0F0F0F0Full) << 4);
+	return __builtin_bswap64(v);
+}
+
+/*
+** Row of n + 1 bits mirrored about its middle: bit x of dst is bit n - x
+** of src. The words are reversed as a whole, which puts bit n - x at
+** x + shift, then shifted down.
+*/
+
+void						reverse_row(const uint64_t *src, uint64_t *dst, size_t n, size_t words)
+{
+	size_t					used;
+	size_t					shift;
+	uint64_t				next;
+
+	used = (n + 64) / 64;
+	shift = used * 64 - 1 - n;
+	memset(dst, 0, words * sizeof(uint64_t));
+	for (size_t i = 0; i < used; i++)
+	{
+		dst[i] = reverse_word(src[used - 1 - i]) >> shift;
+		next = (i + 1 < used) ? reverse_word(src[used - 2 - i]) : 0;
+		if (shift)
+			dst[i] |= next << (64 - shift);
+	}
+}
+
+/*
+** Classifies cells [64k, 64k + 64) of a row at once. rows are the lattice
+** rows (y + 1, z), (y, z), (y + 1, z + 1) and (y, z + 1); lo holds their
+** bits at x and hi at x + 1. A cell is active when its 8 corners are
+** neither all out nor all in.
+*/
+
+void						occupancy_window(uint64_t **rows, size_t k, size_t n, t_window *win)
+{
+	uint64_t				all;
+	uint64_t				any;
+	size_t					left;
+
+	all = ~(uint64_t)0;
+	any = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		win->lo[i] = rows[i][k];
+		win->hi[i] = (rows[i][k] >> 1) | (rows[i][k + 1] << 63);
+		all &= win->lo[i] & win->hi[i];
+		any |= win->lo[i] | win->hi[i];
+	}
+	win->active = any & ~all;
+	left = n - 64 * k;
+	if (left < 64)
+		win->active &= ((uint64_t)1 << left) - 1;
+}
+
+/*
+** Marching cubes case of cell j of the window, built from the corner bits
+** in corner order without a branch.
+*/
+
+uint						window_case(t_window *win, uint j)
+{
+	return (uint)(((win->lo[0] >> j) & 1)
+		| (((win->hi[0] >> j) & 1) << 1)
+		| (((win->hi[1] >> j) & 1) << 2)
+		| (((win->lo[1] >> j) & 1) << 3)
+		| (((win->lo[2] >> j) & 1) << 4)
+		| (((win->hi[2] >> j) & 1) << 5)
+		| (((win->hi[3] >> j) & 1) << 6)
+		| (((win->lo[3] >> j) & 1) << 7));
+}
@@ -0,0 +1,164 @@
+#include "morphosis.h"
+
+/*
+** Adaptive octree over bricks of BRICK_SIZE^3 cells. Blocks are classified
+** coarse to fine and only blocks that may straddle the surface are refined,
+** down to single bricks. The result is one state per brick: bricks left
+** BLOCK_UNKNOWN are sampled and meshed, the others are skipped.
+*/
+
+/*
+** A block is uniform when the box of its lattice points, iterated through
+** z^2 + c as a whole in interval arithmetic, clears |z| = 2 within
+** max_iter iterations (outside) or never reaches it (inside). The bounds
+** hold the float orbit of every point of the box, so the octree never
+** disagrees with the sampler. Intervals only widen, and one wider than
+** the escape circle is given up on before it can overflow.
+*/
+
+int							classify_block(t_fract *f, size_t *lo, size_t *hi)
+{
+	t_julia					*julia;
+	cl_iquat				z;
+	cl_interval				mod_squared;
+	int						bounded;
+
+	julia = f->julia;
+	z.x = cl_interval_make(f->grid.x[lo[0]], f->grid.x[hi[0]]);
+	z.y = cl_interval_make(f->grid.y[lo[1]], f->grid.y[hi[1]]);
+	z.z = cl_interval_make(f->grid.z[lo[2]], f->grid.z[hi[2]]);
+	z.w = cl_interval_make(julia->w, julia->w);
+	bounded = 1;
+	for (uint iter = 0; iter < julia->max_iter; iter++)
+	{
+		z = cl_iquat_sqr_add(z, julia->c, &mod_squared);
+		if (mod_squared.lo > 4.0f)
+			return BLOCK_OUTSIDE;
+		if (!(mod_squared.hi <= 4.0f))
+			bounded = 0;
+		if (!bounded && !(z.x.hi - z.x.lo < 4.0f && z.y.hi - z.y.lo < 4.0f
+			&& z.z.hi - z.z.lo < 4.0f && z.w.hi - z.w.lo < 4.0f))
+			return BLOCK_UNKNOWN;
+	}
+	return bounded ? BLOCK_INSIDE : BLOCK_UNKNOWN;
+}
+
+static void					mark_bricks(t_octree *o, size_t *b, size_t size, unsigned char state)
+{
+	for (size_t z = b[2]; z < b[2] + size && z < o->nb; z++)
+		for (size_t y = b[1]; y < b[1] + size && y < o->nb; y++)
+			for (size_t x = b[0]; x < b[0] + size && x < o->nb; x++)
+				o->bricks[(z * o->nb + y) * o->nb + x] = state;
+}
+
+static void					refine(t_octree *o, t_fract *f, size_t *b, size_t size)
+{
+	size_t					lo[3];
+	size_t					hi[3];
+	size_t					child[3];
+	int						state;
+
+	for (int a = 0; a < 3; a++)
+	{
+		if (b[a] >= o->nb)
+			return;
+		lo[a] = b[a] * BRICK_SIZE;
+		hi[a] = (b[a] + size) * BRICK_SIZE;
+		if (hi[a] > o->n)
+			hi[a] = o->n;
+	}
+	o->blocks++;
+	if ((state = classify_block(f, lo, hi)) != BLOCK_UNKNOWN || size == 1)
+	{
+		mark_bricks(o, b, size, (unsigned char)state);
+		return;
+	}
+	size /= 2;
+	for (int c = 0; c < 8; c++)
+	{
+		child[0] = b[0] + ((c & 1) ? size : 0);
+		child[1] = b[1] + ((c & 2) ? size : 0);
+		child[2] = b[2] + ((c & 4) ? size : 0);
+		refine(o, f, child, size);
+	}
+}
+
+void						build_octree(t_octree *o, t_fract *f, size_t n)
+{
+	size_t					root[3];
+	size_t					size;
+
+	o->n = n;
+	o->nb = (n + BRICK_SIZE - 1) / BRICK_SIZE;
+	o->blocks = 0;
+	if (!(o->bricks = (unsigned char *)malloc(o->nb * o->nb * o->nb)))
+		error(MALLOC_FAIL_ERR, NULL);
+	size = 1;
+	while (size < o->nb)
+		size *= 2;
+	root[0] = 0;
+	root[1] = 0;
+	root[2] = 0;
+	refine(o, f, root, size);
+}
+
+unsigned char				brick_state(t_octree *o, size_t x, size_t y, size_t z)
+{
+	return o->bricks[((z / BRICK_SIZE) * o->nb + y / BRICK_SIZE) * o->nb + x / BRICK_SIZE];
+}
+
+/*
+** Bricks touching lattice index i along one axis: two on a brick boundary,
+** one otherwise.
+*/
+
+static void					adjacent_bricks(t_octree *o, size_t i, size_t *lo, size_t *hi)
+{
+	*hi = i / BRICK_SIZE;
+	if (*hi >= o->nb)
+		*hi = o->nb - 1;
+	*lo = (i % BRICK_SIZE == 0 && i > 0) ? i / BRICK_SIZE - 1 : *hi;
+}
+
+static unsigned char		combine(unsigned char a, unsigned char b)
+{
+	return (a == b) ? a : BLOCK_UNKNOWN;
+}
+
+/*
+** State of every lattice point of row (y, z). A point is known only when
+** all the bricks touching it agree, so every corner of a cell inside an
+** unknown brick is sampled exactly as on the full grid. The row is filled
+** a brick at a time: the points inside brick bx share its column state
+** col[bx], the point on a boundary combines the two around it. col is
+** scratch for nb entries.
+*/
+
+void						lattice_row_state(t_octree *o, size_t y, size_t z,
+								unsigned char *state, unsigned char *col)
+{
+	size_t					ylo;
+	size_t					yhi;
+	size_t					zlo;
+	size_t					zhi;
+	size_t					end;
+
+	adjacent_bricks(o, y, &ylo, &yhi);
+	adjacent_bricks(o, z, &zlo, &zhi);
+	for (size_t bx = 0; bx < o->nb; bx++)
+	{
+		col[bx] = o->bricks[(zlo * o->nb + ylo) * o->nb + bx];
+		col[bx] = combine(col[bx], o->bricks[(zlo * o->nb + yhi) * o->nb + bx]);
+		col[bx] = combine(col[bx], o->bricks[(zhi * o->nb + ylo) * o->nb + bx]);
+		col[bx] = combine(col[bx], o->bricks[(zhi * o->nb + yhi) * o->nb + bx]);
+	}
+	state[0] = col[0];
+	for (size_t bx = 0; bx < o->nb; bx++)
+	{
+		end = (bx + 1) * BRICK_SIZE;
+		end = (end < o->n) ? end : o->n;
+		memset(state + bx * BRICK_SIZE + 1, col[bx], end - bx * BRICK_SIZE);
+		if (bx + 1 < o->nb)
+			state[end] = combine(col[bx], col[bx + 1]);
+	}
+}
@@ -0,0 +1,136 @@
+#include "morphosis.h"
+#include <unistd.h>
+
+static uint					online_cores(void)
+{
+	long					cores;
+
+	cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return (cores > 0) ? (uint)cores : 1;
+}
+
+/*
+** Strips the options out of argc so the positional forms in get_args keep
+** working unchanged. Returns the remaining argument count.
+*/
+
+int							parse_options(int argv, char **argc, t_opts *opts)
+{
+	int						i;
+	int						kept;
+
+	init_opts(opts);
+	i = 1;
+	kept = 1;
+	while (i < argv)
+	{
+		if (!strcmp(argc[i], "-j"))
+		{
+			if (i + 1 >= argv || !isdigit(argc[i + 1][0]))
+				error(ARGS_ERR, NULL);
+			opts->threads = (uint)atoi(argc[i + 1]);
+			if (!opts->threads)
+				opts->threads = online_cores();
+			i += 2;
+		}
+		else if (!strcmp(argc[i], "--field"))
+		{
+			if (i + 1 >= argv)
+				error(ARGS_ERR, NULL);
+			if (!strcmp(argc[i + 1], "distance"))
+				opts->field = FIELD_DISTANCE;
+			else if (!strcmp(argc[i + 1], "binary"))
+				opts->field = FIELD_BINARY;
+			else
+				error(ARGS_ERR, NULL);
+			i += 2;
+		}
+		else if (!strcmp(argc[i], "--mesher"))
+		{
+			if (i + 1 >= argv)
+				error(ARGS_ERR, NULL);
+			if (!strcmp(argc[i + 1], "nets"))
+				opts->mesher = MESHER_NETS;
+			else if (!strcmp(argc[i + 1], "cubes"))
+				opts->mesher = MESHER_CUBES;
+			else
+				error(ARGS_ERR, NULL);
+			i += 2;
+		}
+		else if (!strcmp(argc[i], "--format"))
+		{
+			if (i + 1 >= argv || !(opts->format = format_of(argc[i + 1])))
+				error(ARGS_ERR, NULL);
+			i += 2;
+		}
+		else if (!strcmp(argc[i], "--weld"))
+		{
+			if (i + 1 >= argv || !((opts->weld = (float)atof(argc[i + 1])) > 0.0f))
+				error(ARGS_ERR, NULL);
+			i += 2;
+		}
+		else if (!strcmp(argc[i], "--octree"))
+		{
+			opts->octree = 1;
+			i++;
+		}
+		else if (!strcmp(argc[i], "--symmetry"))
+		{
+			opts->symmetry = 1;
+			i++;
+		}
+		else if (!strcmp(argc[i], "--orbits"))
+		{
+			if (i + 1 >= argv)
+				error(ARGS_ERR, NULL);
+			opts->orbits = argc[i + 1];
+			i += 2;
+		}
+		else if (!strcmp(argc[i], "--refine"))
+		{
+			if (i + 1 >= argv || !isdigit(argc[i + 1][0])
+				|| !(opts->refine = (uint)atoi(argc[i + 1])))
+				error(ARGS_ERR, NULL);
+			i += 2;
+		}
+		else if (!strcmp(argc[i], "--stream-out"))
+		{
+			if (i + 1 >= argv)
+				error(ARGS_ERR, NULL);
+			opts->stream_out = argc[i + 1];
+			i += 2;
+		}
+		else if (!strcmp(argc[i], "--periodicity"))
+		{
+			opts->periodicity = PERIODICITY_ON;
+			i++;
+		}
+		else if (!strcmp(argc[i], "--validate-periodicity"))
+		{
+			opts->periodicity = PERIODICITY_VALIDATE;
+			i++;
+		}
+		else if (!strcmp(argc[i], "--headless"))
+		{
+			opts->headless = 1;
+			i++;
+		}
+		else if (!strcmp(argc[i], "-o"))
+		{
+			if (i + 1 >= argv)
+				error(ARGS_ERR, NULL);
+			opts->output = argc[i + 1];
+			i += 2;
+		}
+		else if (!strcmp(argc[i], "--iter"))
+		{
+			if (i + 1 >= argv || !isdigit(argc[i + 1][0]) || !(opts->iter = atoi(argc[i + 1])))
+				error(ARGS_ERR, NULL);
+			i += 2;
+		}
+		else
+			argc[kept++] = argc[i++];
+	}
+	argc[kept] = NULL;
+	return kept;
+}
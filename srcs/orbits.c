@@ -0,0 +1,285 @@
+#include "morphosis.h"
+#include <limits.h>
+
+/*
+** Orbit state kept between runs, so raising max_iter only continues the
+** orbits that were still bounded. An orbit run k iterations and then m
+** more is bit for bit the orbit run k + m iterations, so a resumed run
+** gives exactly the samples of a cold one.
+*/
+
+static void					fill_header(t_orbit_header *h, t_fract *f, size_t n)
+{
+	memset(h, 0, sizeof(*h));
+	memcpy(h->magic, ORBIT_MAGIC, sizeof(h->magic));
+	h->n = (uint32_t)n;
+	h->max_iter = f->julia->max_iter;
+	h->origin[0] = f->grid.x[0];
+	h->origin[1] = f->grid.y[0];
+	h->origin[2] = f->grid.z[0];
+	h->step = f->step_size;
+	h->w = f->julia->w;
+	h->c[0] = f->julia->c.x;
+	h->c[1] = f->julia->c.y;
+	h->c[2] = f->julia->c.z;
+	h->c[3] = f->julia->c.w;
+}
+
+/*
+** A file only fits the same lattice and the same set, at no more
+** iterations than now.
+*/
+
+static int					same_fractal(t_orbit_header *a, t_orbit_header *b)
+{
+	return (!memcmp(a->magic, b->magic, sizeof(a->magic)) && a->n == b->n
+		&& !memcmp(a->origin, b->origin, sizeof(a->origin)) && a->step == b->step
+		&& a->w == b->w && !memcmp(a->c, b->c, sizeof(a->c)) && a->max_iter <= b->max_iter);
+}
+
+static int					read_plane(FILE *in, t_orbits *o, size_t z, size_t *total)
+{
+	size_t					r;
+	uint64_t				count;
+	size_t					sum;
+	float					*grown;
+
+	sum = 0;
+	for (size_t y = 0; y <= o->n; y++)
+	{
+		r = z * (o->n + 1) + y;
+		if (fread(o->escaped + r * o->words, sizeof(uint64_t), o->words, in) != o->words
+			|| fread(o->stored + r * o->words, sizeof(uint64_t), o->words, in) != o->words)
+			return 0;
+		o->first[r] = *total + sum;
+		for (size_t k = 0; k < o->words; k++)
+			sum += (size_t)__builtin_popcountll(o->stored[r * o->words + k]);
+	}
+	if (fread(&count, sizeof(count), 1, in) != 1 || count != sum)
+		return 0;
+	if (!(grown = (float *)realloc(o->z, (*total + sum) * 4 * sizeof(float) + 1)))
+		error(MALLOC_FAIL_ERR, NULL);
+	o->z = grown;
+	if (fread(o->z + *total * 4, 4 * sizeof(float), sum, in) != sum)
+		return 0;
+	*total += sum;
+	return 1;
+}
+
+/*
+** Orbit state of an earlier run of the same fractal, or NULL when there is
+** none to start from: no file yet, another fractal, or more iterations
+** than now.
+*/
+
+t_orbits					*load_orbits(const char *path, t_fract *f, size_t n, size_t words)
+{
+	FILE					*in;
+	t_orbit_header			want;
+	t_orbit_header			got;
+	t_orbits				*o;
+	size_t					rows;
+	size_t					total;
+
+	if (!(in = fopen(path, "rb")))
+		return NULL;
+	fill_header(&want, f, n);
+	if (fread(&got, sizeof(got), 1, in) != 1 || !same_fractal(&got, &want))
+	{
+		printf("Orbit state: %s does not fit this run, starting cold\n", path);
+		fclose(in);
+		return NULL;
+	}
+	rows = (n + 1) * (n + 1);
+	if (!(o = (t_orbits *)calloc(1, sizeof(t_orbits)))
+		|| !(o->escaped = (uint64_t *)malloc(rows * words * sizeof(uint64_t)))
+		|| !(o->stored = (uint64_t *)malloc(rows * words * sizeof(uint64_t)))
+		|| !(o->first = (size_t *)malloc(rows * sizeof(size_t))))
+		error(MALLOC_FAIL_ERR, NULL);
+	o->n = n;
+	o->words = words;
+	o->max_iter = got.max_iter;
+	total = 0;
+	for (size_t z = 0; z <= n; z++)
+		if (!read_plane(in, o, z, &total))
+		{
+			printf("Orbit state: %s is truncated, starting cold\n", path);
+			clean_orbits(o);
+			fclose(in);
+			return NULL;
+		}
+	fclose(in);
+	printf("Orbit state: continuing %zu orbits from iteration %u\n", total, o->max_iter);
+	return o;
+}
+
+/*
+** The new state goes to a temporary file, moved over path once complete:
+** path may be the file the run started from.
+*/
+
+FILE						*open_orbits(const char *path, t_fract *f, size_t n)
+{
+	FILE					*out;
+	char					tmp[PATH_MAX];
+	t_orbit_header			h;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	if (!(out = fopen(tmp, "wb")))
+		error(OPEN_FILE_ERR, NULL);
+	fill_header(&h, f, n);
+	if (fwrite(&h, sizeof(h), 1, out) != 1)
+		error(WRITE_FILE_ERR, NULL);
+	return out;
+}
+
+void						close_orbits(FILE *out, const char *path)
+{
+	char					tmp[PATH_MAX];
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	if (fclose(out) || rename(tmp, path))
+		error(WRITE_FILE_ERR, NULL);
+}
+
+void						write_record(FILE *out, t_record *rec, size_t n, size_t words)
+{
+	const size_t			plane = (n + 1) * 2 * words;
+	const float				*z;
+	uint64_t				count;
+
+	z = rec->z;
+	for (size_t p = 0; p < rec->planes; p++)
+	{
+		count = rec->counts[p];
+		if (fwrite(rec->bits + p * plane, sizeof(uint64_t), plane, out) != plane
+			|| fwrite(&count, sizeof(count), 1, out) != 1
+			|| fwrite(z, 4 * sizeof(float), count, out) != count)
+			error(WRITE_FILE_ERR, NULL);
+		z += 4 * count;
+	}
+}
+
+static float				*record_orbit(t_record *rec)
+{
+	float					*z;
+
+	if (rec->num_z == rec->cap_z)
+	{
+		rec->cap_z = rec->cap_z ? rec->cap_z + (rec->cap_z >> 1) : 1024;
+		if (!(z = (float *)realloc(rec->z, rec->cap_z * 4 * sizeof(float))))
+			error(MALLOC_FAIL_ERR, NULL);
+		rec->z = z;
+	}
+	return rec->z + 4 * rec->num_z++;
+}
+
+static int					bit(const uint64_t *row, size_t x)
+{
+	return (int)((row[x >> 6] >> (x & 63)) & 1);
+}
+
+/*
+** Sorts the first span points of row y: settled by the octree, known to
+** escape from the last run, continued from the orbit it kept, or started
+** cold. kind remembers which for the second pass.
+*/
+
+static void					split_row(t_build *b, t_worker *w, size_t y, size_t z, size_t span,
+								float *row, size_t *counts)
+{
+	t_fract					*f;
+	t_orbits				*prev;
+	size_t					r;
+	size_t					k;
+	int						stored;
+	const float				*q;
+
+	f = b->data->fract;
+	prev = b->prev;
+	r = z * (b->n + 1) + y;
+	k = prev ? prev->first[r] : 0;
+	for (size_t x = 0; x < span; x++)
+	{
+		stored = prev && bit(prev->stored + r * b->words, x);
+		if (b->octree && w->state[x] != BLOCK_UNKNOWN)
+		{
+			row[x] = (w->state[x] == BLOCK_INSIDE) ? 1.0f : 0.0f;
+			w->kind[x] = (w->state[x] == BLOCK_INSIDE) ? ORBIT_SETTLED : ORBIT_ESCAPED;
+		}
+		else if (prev && bit(prev->escaped + r * b->words, x))
+		{
+			row[x] = 0.0f;
+			w->kind[x] = ORBIT_ESCAPED;
+		}
+		else if (stored)
+		{
+			q = prev->z + 4 * k;
+			for (int c = 0; c < 4; c++)
+				w->warm[c][counts[ORBIT_WARM]] = q[c];
+			w->kind[x] = ORBIT_WARM;
+			counts[ORBIT_WARM]++;
+		}
+		else
+		{
+			w->cold[0][counts[ORBIT_COLD]] = f->grid.x[x];
+			w->cold[1][counts[ORBIT_COLD]] = f->grid.y[y];
+			w->cold[2][counts[ORBIT_COLD]] = f->grid.z[z];
+			w->cold[3][counts[ORBIT_COLD]] = f->julia->w;
+			w->kind[x] = ORBIT_COLD;
+			counts[ORBIT_COLD]++;
+		}
+		k += stored;
+	}
+}
+
+/*
+** Samples the first span points of row y of the binary field through the
+** orbit state: the last run's escapes are taken as they are and its
+** bounded orbits only run the new iterations. The state reached is
+** recorded in rec, the escaped and stored words of the row, when not NULL.
+*/
+
+void						sample_row_orbits(t_build *b, t_worker *w, size_t y, size_t z,
+								size_t span, float *row, uint64_t *rec)
+{
+	t_julia					*julia;
+	size_t					counts[ORBIT_KINDS];
+	float					*out[ORBIT_KINDS];
+	float					*q;
+	float					*const *src;
+	size_t					i;
+
+	julia = b->data->fract->julia;
+	if (b->octree)
+		lattice_row_state(b->octree, y, z, w->state, w->col);
+	memset(counts, 0, sizeof(counts));
+	split_row(b, w, y, z, span, row, counts);
+	out[ORBIT_COLD] = w->orbit + 8 * (b->n + 1);
+	out[ORBIT_WARM] = w->orbit + 9 * (b->n + 1);
+	julia_orbit_batch(julia, w->cold, counts[ORBIT_COLD], julia->max_iter, out[ORBIT_COLD]);
+	if (b->prev)
+		julia_orbit_batch(julia, w->warm, counts[ORBIT_WARM],
+			julia->max_iter - b->prev->max_iter, out[ORBIT_WARM]);
+	w->samples += counts[ORBIT_COLD] + counts[ORBIT_WARM];
+	w->resumed += counts[ORBIT_WARM];
+	memset(counts, 0, sizeof(counts));
+	for (size_t x = 0; x < span; x++)
+	{
+		if (w->kind[x] == ORBIT_COLD || w->kind[x] == ORBIT_WARM)
+		{
+			i = counts[w->kind[x]]++;
+			src = (w->kind[x] == ORBIT_COLD) ? w->cold : w->warm;
+			row[x] = out[w->kind[x]][i];
+			if (rec && row[x] > 0.0f)
+			{
+				q = record_orbit(&w->record);
+				for (int c = 0; c < 4; c++)
+					q[c] = src[c][i];
+				rec[b->words + (x >> 6)] |= (uint64_t)1 << (x & 63);
+			}
+		}
+		if (rec && row[x] == 0.0f)
+			rec[x >> 6] |= (uint64_t)1 << (x & 63);
+	}
+}
@@ -1,45 +1,152 @@
 #include "morphosis.h"
+#include <limits.h>
 
-void 						calculate_point_cloud(t_data *data)
+static void					set_lattice(t_data *data)
 {
 	t_fract 				*fract;
+	double					start;
 
+	start = wall_time();
 	fract = data->fract;
-	fract->grid_size = fract->grid_length / fract->step_size;
+	fract->grid_size = roundf(fract->grid_length / fract->step_size);
+	if (fract->grid_size < 1.0f)
+		fract->grid_size = 1.0f;
 	init_grid(data);
-	init_vertex(data);
 	create_grid(data);
-	define_voxel(fract, fract->step_size);
+	define_voxel(fract);
+	data->timing.grid += wall_time() - start;
+}
+
+/*
+** An intermediate --refine level is a model of its own: it goes to the
+** output path with its step added, streamed or exported, and only the
+** last level reaches the viewer. Orbit state is only kept for the last.
+*/
+
+static void					build_level(t_data *data, t_level *coarse, t_level *keep)
+{
+	t_opts					opts;
+	char					path[PATH_MAX];
+	double					start;
+
+	opts = data->opts;
+	data->opts.orbits = NULL;
+	if (opts.stream_out)
+	{
+		level_path(path, sizeof(path), opts.stream_out, data->fract->step_size);
+		data->opts.stream_out = path;
+	}
+	else
+	{
+		level_path(path, sizeof(path), opts.output, data->fract->step_size);
+		data->opts.output = path;
+	}
+	build_fractal(data, coarse, keep);
+	if (opts.headless && !opts.stream_out)
+	{
+		start = wall_time();
+		export_mesh(data);
+		data->timing.export += wall_time() - start;
+		printf("Level %g exported to %s\n", data->fract->step_size, path);
+	}
+	data->opts = opts;
+	clean_calcs(data);
+}
+
+/*
+** With --refine N the lattice is built N times, from step_size * 2^(N-1)
+** down to step_size. Each level keeps its field for the next one, which
+** then only samples the points in between.
+*/
 
-	build_fractal(data);
+void 						calculate_point_cloud(t_data *data)
+{
+	t_fract 				*fract;
+	t_level					levels[2];
+	t_level					*coarse;
+	t_level					*keep;
+	float					step;
+
+	fract = data->fract;
+	step = fract->step_size;
+	coarse = NULL;
+	for (uint level = data->opts.refine - 1; level > 0; level--)
+	{
+		fract->step_size = ldexpf(step, (int)level);
+		keep = (coarse == &levels[0]) ? &levels[1] : &levels[0];
+		set_lattice(data);
+		build_level(data, coarse, keep);
+		if (coarse)
+			clean_level(coarse);
+		coarse = keep;
+	}
+	fract->step_size = step;
+	set_lattice(data);
+	build_fractal(data, coarse, NULL);
+	if (coarse)
+		clean_level(coarse);
 }
 
 void						create_grid(t_data *data)
 {
-	subdiv_grid(data->fract->p0.x, data->fract->p1.x, data->fract->step_size, data->fract->grid.x);
-	subdiv_grid(data->fract->p0.y, data->fract->p1.y, data->fract->step_size, data->fract->grid.y);
-	subdiv_grid(data->fract->p0.z, data->fract->p1.z, data->fract->step_size, data->fract->grid.z);
+	t_fract 				*f;
+	size_t					n;
+
+	f = data->fract;
+	n = (size_t)f->grid_size;
+	subdiv_grid((f->p0.x + f->p1.x) / 2, f->step_size, n, f->grid.x);
+	subdiv_grid((f->p0.y + f->p1.y) / 2, f->step_size, n, f->grid.y);
+	subdiv_grid((f->p0.z + f->p1.z) / 2, f->step_size, n, f->grid.z);
 }
 
-void 						subdiv_grid(float start, float stop, float step, float *axis)
+/*
+** Fills the n + 1 lattice coordinates of one axis, centred on mid. Each
+** coordinate is computed from its index so no rounding error accumulates.
+*/
+
+void 						subdiv_grid(float mid, float step, size_t n, float *axis)
+{
+	const float				half = (float)n / 2;
+
+	for (size_t i = 0; i <= n; i++)
+		axis[i] = mid + ((float)i - half) * step;
+}
+
+/*
+** Lattice offsets of the 8 cell corners, in marching cubes corner order,
+** and of the 12 edges, each oriented from its lower lattice end.
+*/
+
+static void					define_edges(t_fract *fract)
 {
-	float 					val;
-	int						i;
+	const uint				ends[12][2] = {{0, 1}, {1, 2}, {2, 3}, {3, 0},
+								{4, 5}, {5, 6}, {6, 7}, {7, 4},
+								{0, 4}, {1, 5}, {2, 6}, {3, 7}};
+	t_voxel					*a;
+	t_voxel					*b;
+	t_edge					*e;
 
-	val = start;
-	i = 0;
-	while (val <= stop)
+	for (unsigned i = 0; i < 12; i++)
 	{
-		axis[i++] = val;
-		val += step;
+		e = &fract->edge[i];
+		a = &fract->voxel[ends[i][0]];
+		b = &fract->voxel[ends[i][1]];
+		e->a = (a->dx + a->dy + a->dz < b->dx + b->dy + b->dz) ? ends[i][0] : ends[i][1];
+		e->b = (e->a == ends[i][0]) ? ends[i][1] : ends[i][0];
+		a = &fract->voxel[e->a];
+		b = &fract->voxel[e->b];
+		e->dx = a->dx;
+		e->dy = a->dy;
+		e->dz = a->dz;
+		e->axis = (a->dx != b->dx) ? 0 : (a->dy != b->dy) ? 1 : 2;
 	}
 }
 
-void						define_voxel(t_fract *fract, float s)
+void						define_voxel(t_fract *fract)
 {
-	const float 			zz[2] = {-s / 2, s / 2};
-	const float 			xx[4] = {-s / 2, s / 2, s / 2, -s / 2};
-	const float 			yy[4] = {s / 2, s / 2, -s / 2, -s / 2};
+	const uint	 			zz[2] = {0, 1};
+	const uint	 			xx[4] = {0, 1, 1, 0};
+	const uint	 			yy[4] = {1, 1, 0, 0};
 	unsigned 				n = 0;
 
 	for (unsigned i = 0; i < 2; i++)
@@ -52,4 +159,6 @@ void						define_voxel(t_fract *fract, float s)
 			n++;
 		}
 	}
+	define_edges(fract);
+	define_cases(fract);
 }
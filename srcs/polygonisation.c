@@ -1,127 +1,132 @@
 #include "morphosis.h"
 #include "look-up.h"
 
-static uint 				getCubeIndex(float *v_val, uint pos)
-{
-	uint					cubeindex;
-
-	cubeindex = 0;
-	if (v_val[pos + 0])
-		cubeindex |= 1;
-	if (v_val[pos + 1])
-		cubeindex |= 2;
-	if (v_val[pos + 2])
-		cubeindex |= 4;
-	if (v_val[pos + 3])
-		cubeindex |= 8;
-	if (v_val[pos + 4])
-		cubeindex |= 16;
-	if (v_val[pos + 5])
-		cubeindex |= 32;
-	if (v_val[pos + 6])
-		cubeindex |= 64;
-	if (v_val[pos + 7])
-		cubeindex |= 128;
-	return cubeindex;
-}
+/*
+** Only called on edges whose ends are on opposite sides. A binary field
+** carries no crossing information (outside is exactly 0), so the vertex
+** snaps to the inside corner; signed distances put it at the zero crossing.
+*/
 
 static float3				interpolate(float3 p0, float3 p1, float v0, float v1)
 {
 	float					mu;
 	float3					p;
 
-	if (v0 == 1.0f)
-		return p0;
-	if (v1 == 1.0f)
+	if (v0 == 0.0f)
 		return p1;
-	if ((v1 - v0) == 0.0f)
+	if (v1 == 0.0f)
 		return p0;
-	mu = (1.0f - v0) / (v1 - v0);
+	mu = v0 / (v0 - v1);
 	p = p0 + mu * (p1 - p0);
 	return p;
 }
 
-static float3				*get_vertices(uint cubeindex, float3 *v_pos, float *v_val, uint pos)
+/*
+** One case per cube index: the edges set in edgetable, and the triangles
+** of tritable renumbered from edges to positions in that list, so a cell
+** only ever looks at the edges it crosses. Edges are oriented from their
+** lower end, so those leaving the lower corner of the cell have no offset.
+*/
+
+void						define_cases(t_fract *fract)
 {
-	float3					*vertlist;
+	t_case					*cs;
+	unsigned char			pos[12];
+	uint					lower;
 
-	if (!(vertlist = (float3 *)malloc(12 * sizeof(float3))))
-		return NULL;
+	lower = 0;
+	for (uint e = 0; e < 12; e++)
+		if (!(fract->edge[e].dx | fract->edge[e].dy | fract->edge[e].dz))
+			lower = e;
 
-	if (edgetable[cubeindex] & 1)
-		vertlist[0] = interpolate(v_pos[pos + 0], v_pos[pos + 1], v_val[pos + 0], v_val[pos + 1]);
-	if (edgetable[cubeindex] & 2)
-		vertlist[1] = interpolate(v_pos[pos + 1], v_pos[pos + 2], v_val[pos + 1], v_val[pos + 2]);
-	if (edgetable[cubeindex] & 4)
-		vertlist[2] = interpolate(v_pos[pos + 2], v_pos[pos + 3], v_val[pos + 2], v_val[pos + 3]);
-	if (edgetable[cubeindex] & 8)
-		vertlist[3] = interpolate(v_pos[pos + 3], v_pos[pos + 0], v_val[pos + 3], v_val[pos + 0]);
-	if (edgetable[cubeindex] & 16)
-		vertlist[4] = interpolate(v_pos[pos + 4], v_pos[pos + 5], v_val[pos + 4], v_val[pos + 5]);
-	if (edgetable[cubeindex] & 32)
-		vertlist[5] = interpolate(v_pos[pos + 5], v_pos[pos + 6], v_val[pos + 5], v_val[pos + 6]);
-	if (edgetable[cubeindex] & 64)
-		vertlist[6] = interpolate(v_pos[pos + 6], v_pos[pos + 7], v_val[pos + 6], v_val[pos + 7]);
-	if (edgetable[cubeindex] & 128)
-		vertlist[7] = interpolate(v_pos[pos + 7], v_pos[pos + 4], v_val[pos + 7], v_val[pos + 4]);
-	if (edgetable[cubeindex] & 256)
-		vertlist[8] = interpolate(v_pos[pos + 0], v_pos[pos + 4], v_val[pos + 0], v_val[pos + 4]);
-	if (edgetable[cubeindex] & 512)
-		vertlist[9] = interpolate(v_pos[pos + 1], v_pos[pos + 5], v_val[pos + 1], v_val[pos + 5]);
-	if (edgetable[cubeindex] & 1024)
-		vertlist[10] = interpolate(v_pos[pos + 2], v_pos[pos + 6], v_val[pos + 2], v_val[pos + 6]);
-	if (edgetable[cubeindex] & 2048)
-		vertlist[11] = interpolate(v_pos[pos + 3], v_pos[pos + 7], v_val[pos + 3], v_val[pos + 7]);
-	return vertlist;
+	for (uint i = 0; i < 256; i++)
+	{
+		cs = &fract->cases[i];
+		cs->num_edges = 0;
+		for (uint e = 0; e < 12; e++)
+			if (edgetable[i] & (1 << e))
+			{
+				pos[e] = cs->num_edges;
+				cs->edges[cs->num_edges++] = (unsigned char)e;
+			}
+		cs->axes = 0;
+		for (uint e = 0; e < 12; e++)
+			if ((edgetable[i] & (1 << e)) && !(fract->edge[e].dx | fract->edge[e].dy | fract->edge[e].dz))
+				cs->axes |= 1 << fract->edge[e].axis;
+		cs->lower_in = (i >> fract->edge[lower].a) & 1;
+		cs->num_idx = 0;
+		while ((int)tritable[i][cs->num_idx] != -1)
+		{
+			cs->idx[cs->num_idx] = pos[tritable[i][cs->num_idx]];
+			cs->num_idx++;
+		}
+	}
 }
 
-static float3						**package_triangles(float3 *vertlist, uint cubeindex, uint i, t_data *data)
-{
-	uint2 					len;
-	float3 					**tris_new;
+/*
+** Appends the triangles of one cell to out and returns how many there
+** were. Each crossed edge gets its vertex from the edge cache; only the
+** first cell to reach an edge interpolates it, from the edge's lower end,
+** so neighbouring cells share one vertex. The vertices of the cell are
+** gathered on the stack and its triangles go straight into out. Touches
+** nothing but the cell's own slab, so slabs can be polygonised
+** concurrently.
+*/
 
-	len.x = 0;
-	len.y = 1;
-	tris_new = NULL;
-	if (!(tris_new = alloc_float3_arr(tris_new, &len)))
-		error(MALLOC_FAIL_ERR, data);
+uint 						polygonise(t_cell *cell, t_case *cs, t_edge *edges, t_mesh *out)
+{
+	uint 					verts[12];
+	uint 					*dst;
+	t_edge					*e;
 
-	tris_new[0][0] = vertlist[tritable[cubeindex][i]];
-	tris_new[0][1] = vertlist[tritable[cubeindex][i + 1]];
-	tris_new[0][2] = vertlist[tritable[cubeindex][i + 2]];
-	return tris_new;
+	for (uint k = 0; k < cs->num_edges; k++)
+	{
+		if (*cell->slot[k] == EDGE_NONE)
+		{
+			e = &edges[cs->edges[k]];
+			*mesh_reserve_v(out, 1) = interpolate(cell->pos[e->a], cell->pos[e->b],
+				cell->val[e->a], cell->val[e->b]);
+			*cell->slot[k] = (uint)out->num_v++;
+		}
+		verts[k] = *cell->slot[k];
+	}
+	dst = mesh_reserve_idx(out, cs->num_idx);
+	for (uint i = 0; i < cs->num_idx; i++)
+		dst[i] = verts[cs->idx[i]];
+	out->num_idx += cs->num_idx;
+	return cs->num_idx / 3;
 }
 
-float3 						**polygonise(float3 *v_pos, float *v_val, uint2 *pos, t_data *data)
-{
-	float3					**tris;
-	float3 					**tris_new;
-	float3					*vertlist;
-	uint 					cubeindex;
-	uint 					i;
-	uint2 					len;
+/*
+** Surface nets vertex of one cell: the mean of the crossings of its edges.
+** Corner values have opposite signs across a crossed edge; the binary
+** field is given as +-0.5, so its crossings fall mid-edge.
+*/
 
-	tris = NULL;
-	tris_new = NULL;
-	vertlist = NULL;
-	i = 0;
-	len.x = 0;
-	cubeindex = getCubeIndex(v_val, pos->x);
-	if (edgetable[cubeindex] == 0)
-		return NULL;
-	if (!(vertlist = get_vertices(cubeindex, v_pos, v_val, pos->x)))
-		error(MALLOC_FAIL_ERR, data);
+uint						net_vertex(t_cell *cell, t_case *cs, t_edge *edges, t_mesh *out)
+{
+	float3					*v;
+	float3					p0;
+	float3					p1;
+	float					mu;
+	t_edge					*e;
 
-	while ((int)tritable[cubeindex][i] != -1)
+	v = mesh_reserve_v(out, 1);
+	v->x = 0.0f;
+	v->y = 0.0f;
+	v->z = 0.0f;
+	for (uint k = 0; k < cs->num_edges; k++)
 	{
-		tris_new = package_triangles(vertlist, cubeindex, i, data);
-		len.y = 1;
-		if (!(tris = arr_float3_cat(tris_new, tris, &len)))
-			error(MALLOC_FAIL_ERR, data);
-		i += 3;
+		e = &edges[cs->edges[k]];
+		p0 = cell->pos[e->a];
+		p1 = cell->pos[e->b];
+		mu = cell->val[e->a] / (cell->val[e->a] - cell->val[e->b]);
+		v->x += p0.x + mu * (p1.x - p0.x);
+		v->y += p0.y + mu * (p1.y - p0.y);
+		v->z += p0.z + mu * (p1.z - p0.z);
 	}
-	data->len.y = len.x;
-
-	free(vertlist);
-	return tris;
+	v->x /= cs->num_edges;
+	v->y /= cs->num_edges;
+	v->z /= cs->num_edges;
+	return (uint)out->num_v++;
 }
@@ -0,0 +1,90 @@
+#include "morphosis.h"
+
+/*
+** Levels of --refine halve the step each time. Lattice coordinates are
+** computed from their index, so the point 2i of a level is the point i of
+** the level before it, bit for bit, and its sample is kept rather than
+** taken again: only the points with an odd index are new.
+*/
+
+void						init_level(t_level *l, t_fract *f, size_t n, size_t words)
+{
+	l->n = n;
+	l->words = words;
+	l->step = f->step_size;
+	l->vals = NULL;
+	if (!(l->axis = (float *)malloc(3 * (n + 1) * sizeof(float)))
+		|| !(l->bits = (uint64_t *)malloc((n + 1) * (n + 1) * words * sizeof(uint64_t))))
+		error(MALLOC_FAIL_ERR, NULL);
+	if (f->julia->field != FIELD_BINARY
+		&& !(l->vals = (float *)malloc((n + 1) * (n + 1) * (n + 1) * sizeof(float))))
+		error(MALLOC_FAIL_ERR, NULL);
+	memcpy(l->axis, f->grid.x, (n + 1) * sizeof(float));
+	memcpy(l->axis + (n + 1), f->grid.y, (n + 1) * sizeof(float));
+	memcpy(l->axis + 2 * (n + 1), f->grid.z, (n + 1) * sizeof(float));
+}
+
+/*
+** Whether every point of the coarse level is on the lattice of f: twice
+** as many cells, and the same coordinates at the even indices.
+*/
+
+int							level_fits(t_level *coarse, t_fract *f, size_t n)
+{
+	const float				*axes[3] = {f->grid.x, f->grid.y, f->grid.z};
+	size_t					cn;
+
+	cn = coarse->n;
+	if (n != 2 * cn)
+		return 0;
+	for (int a = 0; a < 3; a++)
+		for (size_t i = 0; i <= cn; i++)
+			if (axes[a][2 * i] != coarse->axis[a * (cn + 1) + i])
+				return 0;
+	return 1;
+}
+
+/*
+** Keeps plane z of the level once sampled. Each plane is written by the
+** one slab that owns it.
+*/
+
+void						keep_plane(t_level *l, size_t z, const float *vals,
+								const uint64_t *bits)
+{
+	size_t					plane;
+
+	plane = (l->n + 1) * (l->n + 1);
+	memcpy(l->bits + z * (l->n + 1) * l->words, bits, (l->n + 1) * l->words * sizeof(uint64_t));
+	if (l->vals)
+		memcpy(l->vals + z * plane, vals, plane * sizeof(float));
+}
+
+float						level_value(t_level *l, size_t x, size_t y, size_t z)
+{
+	const uint64_t			*row;
+
+	if (l->vals)
+		return l->vals[(z * (l->n + 1) + y) * (l->n + 1) + x];
+	row = l->bits + (z * (l->n + 1) + y) * l->words;
+	return (float)((row[x >> 6] >> (x & 63)) & 1);
+}
+
+/*
+** Where an intermediate level goes: path with the step of the level
+** before its extension, fractal.obj -> fractal_0.1.obj.
+*/
+
+void						level_path(char *buf, size_t size, const char *path, float step)
+{
+	const char				*dot;
+	const char				*slash;
+	int						stem;
+
+	dot = strrchr(path, '.');
+	slash = strrchr(path, '/');
+	if (!dot || (slash && dot < slash))
+		dot = path + strlen(path);
+	stem = (int)(dot - path);
+	snprintf(buf, size, "%.*s_%g%s", stem, path, step, dot);
+}
@@ -1,9 +1,28 @@
 #include "morphosis.h"
+#include <float.h>
 
-float 						sample_4D_Julia(t_julia *julia, float3 pos)
+/*
+** Number of iterations a point survives before |z| exceeds the threshold,
+** or julia->max_iter if it never escapes. path, when not NULL, says what
+** decided it: the escape, the iteration limit, or the periodicity check.
+**
+** With periodicity on, the orbit is compared against a reference point
+** that is moved up to the current point at iterations 1, 2, 4, 8, ...
+** (Brent's cycle detection). The iteration is deterministic, so an orbit
+** that comes back exactly to it repeats forever and can never escape: the
+** point is inside without running to max_iter. Orbits drawn into an
+** attracting cycle end up repeating exactly in float arithmetic. A
+** tolerance would also stop slowly escaping orbits that merely crawl.
+** The starting point itself is never compared against: q and -q share
+** their orbit from the first iterate on and must get the same answer.
+*/
+
+uint						julia_escape_path(t_julia *julia, float3 pos, unsigned char *path)
 {
 	cl_quat 				z;
+	cl_quat 				ref;
 	uint 					iter;
+	uint 					next_ref;
 	float					temp_mod_squared;
 	const float				threshold_squared = 4.0f; // 2.0² = 4.0
 
@@ -12,16 +31,89 @@ float 						sample_4D_Julia(t_julia *julia, float3 pos)
 	z.y = pos.y;
 	z.z = pos.z;
 	z.w = julia->w;
+	ref = z;
+	next_ref = 1;
 
 	while (iter < julia->max_iter)
 	{
-		z = cl_quat_mult(z, z);
-		z = cl_quat_sum(z, julia->c);
-		// Use optimized squared magnitude to avoid expensive sqrt()
-		temp_mod_squared = cl_quat_mod_squared(z);
+		// z = z² + c, squared magnitude comes with it (no sqrt needed)
+		z = cl_quat_sqr_add(z, julia->c, &temp_mod_squared);
 		if (temp_mod_squared > threshold_squared)
-			return 0.0f;
+		{
+			if (path)
+				*path = PATH_ESCAPED;
+			return iter;
+		}
+		iter++;
+		if (julia->periodicity == PERIODICITY_OFF)
+			continue;
+		if (iter > 1 && cl_quat_equal(z, ref))
+		{
+			if (path)
+				*path = PATH_PERIODIC;
+			return julia->max_iter;
+		}
+		if (iter == next_ref)
+		{
+			ref = z;
+			next_ref <<= 1;
+		}
+	}
+	if (path)
+		*path = PATH_BOUNDED;
+	return iter;
+}
+
+uint						julia_escape_time(t_julia *julia, float3 pos)
+{
+	return julia_escape_path(julia, pos, NULL);
+}
+
+/*
+** Signed distance estimate: positive inside, negative outside. The set is
+** bounded by the level sets |f^k(z)| = 2, k <= max_iter, and the distance
+** to one of them is about | |z_k| - 2 | / |dz_k|, with |dz_k+1| = 2|z_k||dz_k|.
+** Escaping points use the level set they crossed, bounded points the
+** closest one. The sign always agrees with julia_escape_time without
+** periodicity, which this field never uses since bounded orbits need all
+** their iterations for the minimum. The value is never 0, which marks the
+** binary field.
+*/
+
+float						julia_distance(t_julia *julia, float3 pos)
+{
+	cl_quat 				z;
+	uint 					iter;
+	float					mod;
+	float					mod_squared;
+	float					dz;
+	float					dist;
+
+	iter = 0;
+	z.x = pos.x;
+	z.y = pos.y;
+	z.z = pos.z;
+	z.w = julia->w;
+	mod = sqrtf(cl_quat_mod_squared(z));
+	dz = 1.0f;
+	dist = FLT_MAX;
+
+	while (iter < julia->max_iter)
+	{
+		dz *= 2.0f * mod;
+		z = cl_quat_sqr_add(z, julia->c, &mod_squared);
+		mod = sqrtf(mod_squared);
+		if (mod_squared > 4.0f)
+			return -fmaxf((mod - 2.0f) / dz, FLT_MIN);
+		dist = fminf(dist, (2.0f - mod) / dz);
 		iter++;
 	}
-	return 1.0f;
+	return fmaxf(dist, FLT_MIN);
+}
+
+float 						sample_4D_Julia(t_julia *julia, float3 pos)
+{
+	if (julia->field == FIELD_DISTANCE)
+		return julia_distance(julia, pos);
+	return (julia_escape_time(julia, pos) < julia->max_iter) ? 0.0f : 1.0f;
 }
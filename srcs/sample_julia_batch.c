@@ -0,0 +1,443 @@
+#include "morphosis.h"
+
+/*
+** Batched Julia sampler over SoA coordinates. Every lane runs exactly the
+** scalar recurrence of julia_escape_path, i.e. cl_quat_sqr_add (same
+** operations, same order, no fused multiply-add), so the batch and
+** per-point results are identical.
+*/
+
+#if defined(__clang__)
+# pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+# pragma GCC optimize ("fp-contract=off")
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+# define JULIA_X86 1
+#endif
+
+#define VALIDATE_CHUNK		256
+
+typedef void				(*t_batch_fn)(t_julia *, const float *, const float *,
+								const float *, size_t, float *, unsigned char *);
+typedef void				(*t_orbit_fn)(t_julia *, float **, size_t, uint, float *);
+
+static void					julia_scalar(t_julia *julia, const float *x, const float *y,
+								const float *z, size_t count, float *out, unsigned char *paths)
+{
+	float3					p;
+	uint					iter;
+
+	if (julia->field == FIELD_DISTANCE)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			p.x = x[i];
+			p.y = y[i];
+			p.z = z[i];
+			out[i] = julia_distance(julia, p);
+			if (paths)
+				paths[i] = (out[i] > 0.0f) ? PATH_BOUNDED : PATH_ESCAPED;
+		}
+		return;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		p.x = x[i];
+		p.y = y[i];
+		p.z = z[i];
+		iter = julia_escape_path(julia, p, paths ? paths + i : NULL);
+		out[i] = (iter < julia->max_iter) ? 0.0f : 1.0f;
+	}
+}
+
+/*
+** Runs iters more iterations of the orbits whose current points are given
+** in q, one array per component, and writes the points reached back. out
+** is 1 for the orbits still bounded, whose points are then exact; the
+** points of escaped orbits are meaningless.
+*/
+
+static void					orbit_scalar(t_julia *julia, float **q, size_t count, uint iters,
+								float *out)
+{
+	cl_quat					z;
+	float					mod_squared;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		z.x = q[0][i];
+		z.y = q[1][i];
+		z.z = q[2][i];
+		z.w = q[3][i];
+		out[i] = 1.0f;
+		for (uint iter = 0; iter < iters; iter++)
+		{
+			z = cl_quat_sqr_add(z, julia->c, &mod_squared);
+			if (mod_squared > 4.0f)
+			{
+				out[i] = 0.0f;
+				break;
+			}
+		}
+		q[0][i] = z.x;
+		q[1][i] = z.y;
+		q[2][i] = z.z;
+		q[3][i] = z.w;
+	}
+}
+
+#ifdef JULIA_X86
+
+/*
+** The vector kernels follow julia_escape_path lane by lane: a lane that
+** comes back exactly to its reference point is settled inside
+** and leaves the active set, and the references of all lanes move at the
+** same iterations since the lanes iterate in lockstep.
+*/
+
+__attribute__((target("avx2")))
+static void					julia_avx2(t_julia *julia, const float *x, const float *y,
+								const float *z, size_t count, float *out, unsigned char *paths)
+{
+	const __m256			cx = _mm256_set1_ps(julia->c.x);
+	const __m256			cy = _mm256_set1_ps(julia->c.y);
+	const __m256			cz = _mm256_set1_ps(julia->c.z);
+	const __m256			cw = _mm256_set1_ps(julia->c.w);
+	const __m256			threshold = _mm256_set1_ps(4.0f);
+	const int				periodic = (julia->periodicity != PERIODICITY_OFF);
+	__m256					zx, zy, zz, zw, rx, rw, active, settled;
+	__m256					ref_x, ref_y, ref_z, ref_w;
+	uint					next_ref;
+	int						bounded;
+	int						cycled;
+	size_t					i;
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		zx = _mm256_loadu_ps(x + i);
+		zy = _mm256_loadu_ps(y + i);
+		zz = _mm256_loadu_ps(z + i);
+		zw = _mm256_set1_ps(julia->w);
+		ref_x = zx;
+		ref_y = zy;
+		ref_z = zz;
+		ref_w = zw;
+		next_ref = 1;
+		active = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		settled = _mm256_setzero_ps();
+		for (uint iter = 0; iter < julia->max_iter; iter++)
+		{
+			rw = _mm256_add_ps(zx, zx);
+			rx = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_mul_ps(zx, zx),
+				_mm256_mul_ps(zy, zy)), _mm256_mul_ps(zz, zz)), _mm256_mul_ps(zw, zw));
+			zy = _mm256_add_ps(_mm256_mul_ps(rw, zy), cy);
+			zz = _mm256_add_ps(_mm256_mul_ps(rw, zz), cz);
+			zw = _mm256_add_ps(_mm256_mul_ps(rw, zw), cw);
+			zx = _mm256_add_ps(rx, cx);
+			rx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(zx, zx),
+				_mm256_mul_ps(zy, zy)), _mm256_mul_ps(zz, zz)), _mm256_mul_ps(zw, zw));
+			active = _mm256_andnot_ps(_mm256_cmp_ps(rx, threshold, _CMP_GT_OQ), active);
+			if (periodic)
+			{
+				if (iter > 0)
+				{
+					rx = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(zx, ref_x, _CMP_EQ_OQ),
+						_mm256_cmp_ps(zy, ref_y, _CMP_EQ_OQ)), _mm256_and_ps(_mm256_cmp_ps(zz,
+						ref_z, _CMP_EQ_OQ), _mm256_cmp_ps(zw, ref_w, _CMP_EQ_OQ)));
+					rx = _mm256_and_ps(rx, active);
+					settled = _mm256_or_ps(settled, rx);
+					active = _mm256_andnot_ps(rx, active);
+				}
+				if (iter + 1 == next_ref)
+				{
+					ref_x = zx;
+					ref_y = zy;
+					ref_z = zz;
+					ref_w = zw;
+					next_ref <<= 1;
+				}
+			}
+			if (!_mm256_movemask_ps(active))
+				break;
+		}
+		_mm256_storeu_ps(out + i, _mm256_and_ps(_mm256_or_ps(active, settled),
+			_mm256_set1_ps(1.0f)));
+		if (!paths)
+			continue;
+		bounded = _mm256_movemask_ps(active);
+		cycled = _mm256_movemask_ps(settled);
+		for (int l = 0; l < 8; l++)
+			paths[i + l] = ((cycled >> l) & 1) ? PATH_PERIODIC
+				: ((bounded >> l) & 1) ? PATH_BOUNDED : PATH_ESCAPED;
+	}
+	julia_scalar(julia, x + i, y + i, z + i, count - i, out + i, paths ? paths + i : NULL);
+}
+
+__attribute__((target("avx512f")))
+static void					julia_avx512(t_julia *julia, const float *x, const float *y,
+								const float *z, size_t count, float *out, unsigned char *paths)
+{
+	const __m512			cx = _mm512_set1_ps(julia->c.x);
+	const __m512			cy = _mm512_set1_ps(julia->c.y);
+	const __m512			cz = _mm512_set1_ps(julia->c.z);
+	const __m512			cw = _mm512_set1_ps(julia->c.w);
+	const __m512			threshold = _mm512_set1_ps(4.0f);
+	const int				periodic = (julia->periodicity != PERIODICITY_OFF);
+	__m512					zx, zy, zz, zw, rx, rw;
+	__m512					ref_x, ref_y, ref_z, ref_w;
+	__mmask16				active;
+	__mmask16				settled;
+	__mmask16				cycle;
+	uint					next_ref;
+	size_t					i;
+
+	for (i = 0; i + 16 <= count; i += 16)
+	{
+		zx = _mm512_loadu_ps(x + i);
+		zy = _mm512_loadu_ps(y + i);
+		zz = _mm512_loadu_ps(z + i);
+		zw = _mm512_set1_ps(julia->w);
+		ref_x = zx;
+		ref_y = zy;
+		ref_z = zz;
+		ref_w = zw;
+		next_ref = 1;
+		active = 0xFFFF;
+		settled = 0;
+		for (uint iter = 0; iter < julia->max_iter; iter++)
+		{
+			rw = _mm512_add_ps(zx, zx);
+			rx = _mm512_sub_ps(_mm512_sub_ps(_mm512_sub_ps(_mm512_mul_ps(zx, zx),
+				_mm512_mul_ps(zy, zy)), _mm512_mul_ps(zz, zz)), _mm512_mul_ps(zw, zw));
+			zy = _mm512_add_ps(_mm512_mul_ps(rw, zy), cy);
+			zz = _mm512_add_ps(_mm512_mul_ps(rw, zz), cz);
+			zw = _mm512_add_ps(_mm512_mul_ps(rw, zw), cw);
+			zx = _mm512_add_ps(rx, cx);
+			rx = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(zx, zx),
+				_mm512_mul_ps(zy, zy)), _mm512_mul_ps(zz, zz)), _mm512_mul_ps(zw, zw));
+			active &= ~_mm512_cmp_ps_mask(rx, threshold, _CMP_GT_OQ);
+			if (periodic)
+			{
+				if (iter > 0)
+				{
+					cycle = active & _mm512_cmp_ps_mask(zx, ref_x, _CMP_EQ_OQ)
+						& _mm512_cmp_ps_mask(zy, ref_y, _CMP_EQ_OQ)
+						& _mm512_cmp_ps_mask(zz, ref_z, _CMP_EQ_OQ)
+						& _mm512_cmp_ps_mask(zw, ref_w, _CMP_EQ_OQ);
+					settled |= cycle;
+					active &= ~cycle;
+				}
+				if (iter + 1 == next_ref)
+				{
+					ref_x = zx;
+					ref_y = zy;
+					ref_z = zz;
+					ref_w = zw;
+					next_ref <<= 1;
+				}
+			}
+			if (!active)
+				break;
+		}
+		_mm512_storeu_ps(out + i, _mm512_maskz_mov_ps(active | settled, _mm512_set1_ps(1.0f)));
+		if (!paths)
+			continue;
+		for (int l = 0; l < 16; l++)
+			paths[i + l] = ((settled >> l) & 1) ? PATH_PERIODIC
+				: ((active >> l) & 1) ? PATH_BOUNDED : PATH_ESCAPED;
+	}
+	julia_scalar(julia, x + i, y + i, z + i, count - i, out + i, paths ? paths + i : NULL);
+}
+
+/*
+** Orbits come a few at a time, so the last vector is masked rather than
+** left to the scalar kernel. Lanes past count start at 0 and never count.
+*/
+
+__attribute__((target("avx2")))
+static void					orbit_avx2(t_julia *julia, float **q, size_t count, uint iters,
+								float *out)
+{
+	const __m256			cx = _mm256_set1_ps(julia->c.x);
+	const __m256			cy = _mm256_set1_ps(julia->c.y);
+	const __m256			cz = _mm256_set1_ps(julia->c.z);
+	const __m256			cw = _mm256_set1_ps(julia->c.w);
+	const __m256			threshold = _mm256_set1_ps(4.0f);
+	const __m256i			lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256					zx, zy, zz, zw, rx, rw, active;
+	__m256i					mask;
+
+	for (size_t i = 0; i < count; i += 8)
+	{
+		mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(count - i < 8 ? count - i : 8)), lanes);
+		zx = _mm256_maskload_ps(q[0] + i, mask);
+		zy = _mm256_maskload_ps(q[1] + i, mask);
+		zz = _mm256_maskload_ps(q[2] + i, mask);
+		zw = _mm256_maskload_ps(q[3] + i, mask);
+		active = _mm256_castsi256_ps(mask);
+		for (uint iter = 0; iter < iters; iter++)
+		{
+			rw = _mm256_add_ps(zx, zx);
+			rx = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_mul_ps(zx, zx),
+				_mm256_mul_ps(zy, zy)), _mm256_mul_ps(zz, zz)), _mm256_mul_ps(zw, zw));
+			zy = _mm256_add_ps(_mm256_mul_ps(rw, zy), cy);
+			zz = _mm256_add_ps(_mm256_mul_ps(rw, zz), cz);
+			zw = _mm256_add_ps(_mm256_mul_ps(rw, zw), cw);
+			zx = _mm256_add_ps(rx, cx);
+			rx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(zx, zx),
+				_mm256_mul_ps(zy, zy)), _mm256_mul_ps(zz, zz)), _mm256_mul_ps(zw, zw));
+			active = _mm256_andnot_ps(_mm256_cmp_ps(rx, threshold, _CMP_GT_OQ), active);
+			if (!_mm256_movemask_ps(active))
+				break;
+		}
+		_mm256_maskstore_ps(out + i, mask, _mm256_and_ps(active, _mm256_set1_ps(1.0f)));
+		_mm256_maskstore_ps(q[0] + i, mask, zx);
+		_mm256_maskstore_ps(q[1] + i, mask, zy);
+		_mm256_maskstore_ps(q[2] + i, mask, zz);
+		_mm256_maskstore_ps(q[3] + i, mask, zw);
+	}
+}
+
+__attribute__((target("avx512f")))
+static void					orbit_avx512(t_julia *julia, float **q, size_t count, uint iters,
+								float *out)
+{
+	const __m512			cx = _mm512_set1_ps(julia->c.x);
+	const __m512			cy = _mm512_set1_ps(julia->c.y);
+	const __m512			cz = _mm512_set1_ps(julia->c.z);
+	const __m512			cw = _mm512_set1_ps(julia->c.w);
+	const __m512			threshold = _mm512_set1_ps(4.0f);
+	__m512					zx, zy, zz, zw, rx, rw;
+	__mmask16				mask;
+	__mmask16				active;
+
+	for (size_t i = 0; i < count; i += 16)
+	{
+		mask = (count - i < 16) ? (__mmask16)((1u << (count - i)) - 1) : 0xFFFF;
+		zx = _mm512_maskz_loadu_ps(mask, q[0] + i);
+		zy = _mm512_maskz_loadu_ps(mask, q[1] + i);
+		zz = _mm512_maskz_loadu_ps(mask, q[2] + i);
+		zw = _mm512_maskz_loadu_ps(mask, q[3] + i);
+		active = mask;
+		for (uint iter = 0; iter < iters; iter++)
+		{
+			rw = _mm512_add_ps(zx, zx);
+			rx = _mm512_sub_ps(_mm512_sub_ps(_mm512_sub_ps(_mm512_mul_ps(zx, zx),
+				_mm512_mul_ps(zy, zy)), _mm512_mul_ps(zz, zz)), _mm512_mul_ps(zw, zw));
+			zy = _mm512_add_ps(_mm512_mul_ps(rw, zy), cy);
+			zz = _mm512_add_ps(_mm512_mul_ps(rw, zz), cz);
+			zw = _mm512_add_ps(_mm512_mul_ps(rw, zw), cw);
+			zx = _mm512_add_ps(rx, cx);
+			rx = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(zx, zx),
+				_mm512_mul_ps(zy, zy)), _mm512_mul_ps(zz, zz)), _mm512_mul_ps(zw, zw));
+			active &= ~_mm512_cmp_ps_mask(rx, threshold, _CMP_GT_OQ);
+			if (!active)
+				break;
+		}
+		_mm512_mask_storeu_ps(out + i, mask, _mm512_maskz_mov_ps(active, _mm512_set1_ps(1.0f)));
+		_mm512_mask_storeu_ps(q[0] + i, mask, zx);
+		_mm512_mask_storeu_ps(q[1] + i, mask, zy);
+		_mm512_mask_storeu_ps(q[2] + i, mask, zz);
+		_mm512_mask_storeu_ps(q[3] + i, mask, zw);
+	}
+}
+
+#endif
+
+static t_batch_fn			g_batch_fn = NULL;
+static t_orbit_fn			g_orbit_fn = NULL;
+static pthread_once_t		g_batch_once = PTHREAD_ONCE_INIT;
+
+static void					select_batch_fn(void)
+{
+	g_batch_fn = julia_scalar;
+	g_orbit_fn = orbit_scalar;
+#ifdef JULIA_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+	{
+		g_batch_fn = julia_avx512;
+		g_orbit_fn = orbit_avx512;
+	}
+	else if (__builtin_cpu_supports("avx2"))
+	{
+		g_batch_fn = julia_avx2;
+		g_orbit_fn = orbit_avx2;
+	}
+#endif
+}
+
+/*
+** Runs the points both ways, VALIDATE_CHUNK at a time so the exhaustive
+** values fit on the stack. A point the periodicity check settled that
+** escapes after all is marked PATH_OVERTURNED, and out always ends up with
+** the exhaustive values.
+*/
+
+static void					validate_periodic(t_julia *julia, const float *x, const float *y,
+								const float *z, size_t count, float *out, unsigned char *paths)
+{
+	t_julia					exhaustive;
+	float					full[VALIDATE_CHUNK];
+	size_t					len;
+
+	exhaustive = *julia;
+	exhaustive.periodicity = PERIODICITY_OFF;
+	for (size_t i = 0; i < count; i += len)
+	{
+		len = (count - i < VALIDATE_CHUNK) ? count - i : VALIDATE_CHUNK;
+		g_batch_fn(julia, x + i, y + i, z + i, len, out + i, paths + i);
+		g_batch_fn(&exhaustive, x + i, y + i, z + i, len, full, NULL);
+		for (size_t j = 0; j < len; j++)
+		{
+			if (paths[i + j] == PATH_PERIODIC && full[j] == 0.0f)
+				paths[i + j] = PATH_OVERTURNED;
+			out[i + j] = full[j];
+		}
+	}
+}
+
+/*
+** Writes the field value of each point to out, as sample_4D_Julia does,
+** and, when paths is not NULL, the PATH_* that decided it. The distance
+** field has no vector kernel and always runs scalar. Validating the
+** periodicity check needs paths; without them the points are simply run
+** to the end.
+*/
+
+void						sample_4D_Julia_batch(t_julia *julia, const float *x, const float *y,
+								const float *z, size_t count, float *out, unsigned char *paths)
+{
+	t_julia					exhaustive;
+
+	pthread_once(&g_batch_once, select_batch_fn);
+	if (julia->field == FIELD_DISTANCE)
+		julia_scalar(julia, x, y, z, count, out, paths);
+	else if (julia->periodicity == PERIODICITY_VALIDATE && !paths)
+	{
+		exhaustive = *julia;
+		exhaustive.periodicity = PERIODICITY_OFF;
+		g_batch_fn(&exhaustive, x, y, z, count, out, NULL);
+	}
+	else if (julia->periodicity == PERIODICITY_VALIDATE)
+		validate_periodic(julia, x, y, z, count, out, paths);
+	else
+		g_batch_fn(julia, x, y, z, count, out, paths);
+}
+
+/*
+** Continues the orbits in q by iters iterations, see orbit_scalar. Running
+** an orbit k iterations and then m more gives bit for bit the orbit and
+** the answer of running it k + m iterations at once, as julia_escape_time
+** does when started from the lattice point.
+*/
+
+void						julia_orbit_batch(t_julia *julia, float **q, size_t count, uint iters,
+								float *out)
+{
+	pthread_once(&g_batch_once, select_batch_fn);
+	g_orbit_fn(julia, q, count, iters, out);
+}
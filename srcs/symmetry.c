@@ -0,0 +1,124 @@
+#include "morphosis.h"
+
+/*
+** Sign flips of the slice that leave z^2 + c unchanged, bit for bit:
+** - y -> -y when c.y == 0, and z -> -z when c.z == 0: the flipped component
+**   of every iterate is the exact negation of the original one, every
+**   other component is the same;
+** - q -> -q has the same orbit after the first step, and w -> -w is again
+**   a flip when c.w == 0, so (x, y, z) -> (-x, -y, -z) when the slice is
+**   at w == 0 or c.w == 0.
+** Products of those are symmetries too. A flip is only used along axes
+** whose lattice is exactly its own mirror image.
+*/
+
+static int					mirrored(const float *axis, size_t n)
+{
+	for (size_t i = 0; i <= n; i++)
+		if (axis[n - i] != -axis[i])
+			return 0;
+	return 1;
+}
+
+static uint					symmetry_group(t_fract *f, size_t n)
+{
+	t_julia					*julia;
+	uint					axes;
+	uint					gens[3];
+	uint					group;
+	uint					flip;
+
+	julia = f->julia;
+	axes = (mirrored(f->grid.x, n) ? MIRROR_X : 0)
+		| (mirrored(f->grid.y, n) ? MIRROR_Y : 0)
+		| (mirrored(f->grid.z, n) ? MIRROR_Z : 0);
+	gens[0] = (julia->c.y == 0.0f) ? MIRROR_Y : 0;
+	gens[1] = (julia->c.z == 0.0f) ? MIRROR_Z : 0;
+	gens[2] = (julia->w == 0.0f || julia->c.w == 0.0f) ? MIRROR_X | MIRROR_Y | MIRROR_Z : 0;
+	group = 0;
+	for (uint m = 0; m < 8; m++)
+	{
+		flip = ((m & 1) ? gens[0] : 0) ^ ((m & 2) ? gens[1] : 0) ^ ((m & 4) ? gens[2] : 0);
+		if (!(flip & ~axes))
+			group |= 1u << flip;
+	}
+	return group;
+}
+
+/*
+** Smallest flip of the group that has all the axes of need and none of
+** skip, or -1.
+*/
+
+static int					pick(uint group, uint need, uint skip)
+{
+	for (uint m = 1; m < 8; m++)
+		if ((group >> m) & 1 && (m & need) == need && !(m & skip))
+			return (int)m;
+	return -1;
+}
+
+/*
+** Planes z < n - z are kept for the planes they mirror: their occupancy
+** rows, and their values when the field is not binary.
+*/
+
+void						init_symmetry(t_symmetry *s, t_fract *f, size_t n, size_t words)
+{
+	uint					group;
+	size_t					planes;
+
+	group = symmetry_group(f, n);
+	s->plane = pick(group, MIRROR_Z, 0);
+	s->row = pick(group, MIRROR_Y, MIRROR_Z);
+	s->point = (pick(group, MIRROR_X, MIRROR_Y | MIRROR_Z) >= 0);
+	s->vals = NULL;
+	s->bits = NULL;
+	s->ready = NULL;
+	pthread_cond_init(&s->stored, NULL);
+	if (s->plane < 0)
+		return;
+	planes = (n + 1) / 2;
+	if (!(s->bits = (uint64_t *)malloc(planes * (n + 1) * words * sizeof(uint64_t))))
+		error(MALLOC_FAIL_ERR, NULL);
+	if (f->julia->field != FIELD_BINARY
+		&& !(s->vals = (float *)malloc(planes * (n + 1) * (n + 1) * sizeof(float))))
+		error(MALLOC_FAIL_ERR, NULL);
+	if (!(s->ready = (unsigned char *)calloc(planes, 1)))
+		error(MALLOC_FAIL_ERR, NULL);
+}
+
+/*
+** Keeps plane z once it has been sampled and wakes the workers waiting
+** for it. Only the slab that samples z as its upper plane stores it, so
+** each plane is written exactly once.
+*/
+
+void						store_plane(t_symmetry *s, pthread_mutex_t *lock, size_t z,
+								const float *vals, const uint64_t *bits, size_t n, size_t words)
+{
+	size_t					plane;
+
+	plane = (n + 1) * (n + 1);
+	memcpy(s->bits + z * (n + 1) * words, bits, (n + 1) * words * sizeof(uint64_t));
+	if (s->vals)
+		memcpy(s->vals + z * plane, vals, plane * sizeof(float));
+	pthread_mutex_lock(lock);
+	s->ready[z] = 1;
+	pthread_cond_broadcast(&s->stored);
+	pthread_mutex_unlock(lock);
+}
+
+/*
+** Waits until plane z is stored. It is sampled by the same slab, earlier
+** in its sweep, or by an earlier slab, and slabs only wait on planes
+** below their own, so the wait always ends.
+*/
+
+void						wait_plane(t_symmetry *s, pthread_mutex_t *lock, size_t z)
+{
+	pthread_mutex_lock(lock);
+	while (!s->ready[z])
+		pthread_cond_wait(&s->stored, lock);
+	pthread_mutex_unlock(lock);
+}
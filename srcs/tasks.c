@@ -0,0 +1,156 @@
+#include "morphosis.h"
+
+/*
+** Work-stealing pool. Each worker has a deque of tasks: it pushes and pops
+** at the tail, idle workers steal at the head, so a thief takes the
+** largest piece left. A task covers a range of items and is split in
+** halves down to its grain as it starts: the halves it does not run
+** itself are left for the owner or for thieves. Every event a waiting
+** worker may be waiting for bumps epoch, so sleeping never misses one;
+** the lock is only taken to wake workers when some are asleep. Only the
+** sampling of plane rows runs on it: meshing stays with the slab's owner,
+** which threads the rolling edge cache and the vertex numbering.
+*/
+
+void						init_pool(t_pool *p, uint workers)
+{
+	p->count = workers;
+	p->epoch = 0;
+	p->sleepers = 0;
+	if (!(p->deques = (t_deque *)calloc(workers, sizeof(t_deque))))
+		error(MALLOC_FAIL_ERR, NULL);
+	for (uint i = 0; i < workers; i++)
+		pthread_mutex_init(&p->deques[i].lock, NULL);
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->wake, NULL);
+}
+
+/*
+** A sleeper counts itself before it reads epoch, and the waker bumps epoch
+** before it reads sleepers, both sequentially consistent: either the
+** sleeper sees the new epoch and does not wait, or the waker sees it and
+** broadcasts under the lock.
+*/
+
+void						pool_wake(t_pool *p)
+{
+	__atomic_add_fetch(&p->epoch, 1, __ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(&p->sleepers, __ATOMIC_SEQ_CST))
+		return;
+	pthread_mutex_lock(&p->lock);
+	pthread_cond_broadcast(&p->wake);
+	pthread_mutex_unlock(&p->lock);
+}
+
+static void					push(t_pool *p, uint me, t_task *t)
+{
+	t_deque					*d;
+	t_task					*grown;
+
+	d = &p->deques[me];
+	pthread_mutex_lock(&d->lock);
+	if (d->tail == d->cap)
+	{
+		d->cap = d->cap ? 2 * d->cap : 64;
+		if (!(grown = (t_task *)realloc(d->tasks, d->cap * sizeof(t_task))))
+			error(MALLOC_FAIL_ERR, NULL);
+		d->tasks = grown;
+	}
+	d->tasks[d->tail++] = *t;
+	pthread_mutex_unlock(&d->lock);
+	pool_wake(p);
+}
+
+/*
+** Takes a task from the tail of deque d for its owner, or from its head
+** for a thief.
+*/
+
+static int					take(t_deque *d, t_task *t, int steal)
+{
+	int						found;
+
+	pthread_mutex_lock(&d->lock);
+	found = (d->head < d->tail);
+	if (found)
+		*t = steal ? d->tasks[d->head++] : d->tasks[--d->tail];
+	if (d->head == d->tail)
+	{
+		d->head = 0;
+		d->tail = 0;
+	}
+	pthread_mutex_unlock(&d->lock);
+	return found;
+}
+
+void						pool_run(t_pool *p, uint me, t_task task)
+{
+	t_task					half;
+	size_t					done;
+
+	while (task.hi - task.lo > task.grain)
+	{
+		half = task;
+		half.lo = task.lo + (task.hi - task.lo) / 2;
+		task.hi = half.lo;
+		push(p, me, &half);
+	}
+	task.run(task.arg, me, task.lo, task.hi);
+	p->deques[me].ran++;
+	done = task.hi - task.lo;
+	if (__atomic_sub_fetch(task.pending, done, __ATOMIC_ACQ_REL) == 0)
+		pool_wake(p);
+}
+
+/*
+** Runs one task: the worker's own latest, or the oldest of another
+** worker, looked for from the next worker on.
+*/
+
+static int					run_one(t_pool *p, uint me)
+{
+	t_task					t;
+
+	if (take(&p->deques[me], &t, 0))
+	{
+		pool_run(p, me, t);
+		return 1;
+	}
+	for (uint i = 1; i < p->count; i++)
+		if (take(&p->deques[(me + i) % p->count], &t, 1))
+		{
+			p->deques[me].stolen++;
+			pool_run(p, me, t);
+			return 1;
+		}
+	return 0;
+}
+
+/*
+** Runs tasks, its own first, until *counter reaches value. The counter is
+** only ever moved towards value, by a task or under a lock, and whoever
+** moves it wakes the pool.
+*/
+
+void						pool_wait(t_pool *p, uint me, size_t *counter, size_t value)
+{
+	size_t					epoch;
+	double					start;
+
+	while (1)
+	{
+		epoch = __atomic_load_n(&p->epoch, __ATOMIC_ACQUIRE);
+		if (__atomic_load_n(counter, __ATOMIC_ACQUIRE) == value)
+			return;
+		if (run_one(p, me))
+			continue;
+		start = wall_time();
+		pthread_mutex_lock(&p->lock);
+		__atomic_add_fetch(&p->sleepers, 1, __ATOMIC_SEQ_CST);
+		while (__atomic_load_n(&p->epoch, __ATOMIC_SEQ_CST) == epoch)
+			pthread_cond_wait(&p->wake, &p->lock);
+		__atomic_sub_fetch(&p->sleepers, 1, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&p->lock);
+		p->deques[me].idle += wall_time() - start;
+	}
+}
@@ -1,106 +1,67 @@
 #include "morphosis.h"
+#include <time.h>
 
-// Optimized memory allocation with exponential growth to avoid O(n²) complexity
-float3						**alloc_float3_arr_optimized(float3 **mem, uint2 *len, uint *capacity)
+double						wall_time(void)
 {
-	uint 					required_size = len->x + len->y;
-	
-	if (!required_size)
-		return NULL;
-	
-	// If we need more space than current capacity, grow exponentially
-	if (required_size > *capacity)
-	{
-		// Grow by 1.5x or to required size, whichever is larger
-		uint new_capacity = (*capacity > 0) ? *capacity : 16;
-		while (new_capacity < required_size)
-			new_capacity = new_capacity + (new_capacity >> 1); // 1.5x growth
-		
-		if (!mem)
-		{
-			if (!(mem = (float3 **)malloc(sizeof(float3 *) * new_capacity)))
-				return NULL;
-		}
-		else
-		{
-			if (!(mem = (float3 **)realloc(mem, sizeof(float3 *) * new_capacity)))
-				return NULL;
-		}
-		
-		// Allocate memory for new triangles
-		for (uint c = *capacity; c < new_capacity; c++)
-		{
-			if (!(mem[c] = (float3 *)malloc(3 * sizeof(float3))))
-				return NULL;
-		}
-		*capacity = new_capacity;
-	}
-	
-	return mem;
+	struct timespec			ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
 }
 
-// Legacy function - simplified version without optimization for now
-float3						**alloc_float3_arr(float3 **mem, uint2 *len)
+void						init_mesh(t_mesh *mesh)
 {
-	uint 					size;
-
-	size = len->x + len->y;
-	if (!size)
-		return NULL;
-	if (!mem)
-	{
-		if (!(mem = (float3 **)malloc(sizeof(float3 *) * size)))
-			return NULL;
-		for (uint c = len->x; c < size; c++)
-		{
-			if (!(mem[c] = (float3 *)malloc(3 * sizeof(float3))))
-				return NULL;
-		}
-	}
-	else
-	{
-		if (!(mem = (float3 **)realloc(mem, sizeof(float3 *) * size)))
-			return NULL;
-		for (uint c = len->x; c < size; c++)
-		{
-			if (!(mem[c] = (float3 *)malloc(3 * sizeof(float3))))
-				return NULL;
-		}
-	}
-	return mem;
+	mesh->v = NULL;
+	mesh->idx = NULL;
+	mesh->num_v = 0;
+	mesh->num_idx = 0;
+	mesh->cap_v = 0;
+	mesh->cap_idx = 0;
+	mesh->ordered = 0;
 }
 
-float3						**arr_float3_cat(float3 **f_from, float3 **f_to, uint2 *len)
+/*
+** Capacity for at least need elements, grown by 1.5x so appending n
+** elements costs O(log n) reallocs.
+*/
+
+static size_t				grow(size_t cap, size_t need)
 {
-	uint					from_c;
-	uint 					to_c;
-	uint 					res_c;
+	cap = (cap > 0) ? cap : 1024;
+	while (cap < need)
+		cap = cap + (cap >> 1);
+	return cap;
+}
 
-	res_c = len->x + len->y;
-	from_c = 0;
-	to_c = len->x;
-	if (!(f_to = alloc_float3_arr(f_to, len)))
-		return NULL;
+/*
+** Make room for count more vertices or indices and return where they go.
+** Running out of memory is fatal, as everywhere else in the build.
+*/
+
+float3						*mesh_reserve_v(t_mesh *mesh, size_t count)
+{
+	float3					*v;
 
-	while (to_c < res_c)
+	if (mesh->num_v + count > mesh->cap_v)
 	{
-		f_to[to_c][0] = f_from[from_c][0];
-		f_to[to_c][1] = f_from[from_c][1];
-		f_to[to_c][2] = f_from[from_c][2];
-		to_c++;
-		from_c++;
+		mesh->cap_v = grow(mesh->cap_v, mesh->num_v + count);
+		if (!(v = (float3 *)realloc(mesh->v, mesh->cap_v * sizeof(float3))))
+			error(MALLOC_FAIL_ERR, NULL);
+		mesh->v = v;
 	}
-	len->x = res_c;
+	return mesh->v + mesh->num_v;
+}
+
+uint						*mesh_reserve_idx(t_mesh *mesh, size_t count)
+{
+	uint					*idx;
 
-	if (f_from)
+	if (mesh->num_idx + count > mesh->cap_idx)
 	{
-		for (uint i = 0; i < len->y; i++)
-			free(f_from[i]);
-		free(f_from);
-		f_from = NULL;
+		mesh->cap_idx = grow(mesh->cap_idx, mesh->num_idx + count);
+		if (!(idx = (uint *)realloc(mesh->idx, mesh->cap_idx * sizeof(uint))))
+			error(MALLOC_FAIL_ERR, NULL);
+		mesh->idx = idx;
 	}
-
-	len->y = 0;
-	f_from = NULL;
-	return f_to;
+	return mesh->idx + mesh->num_idx;
 }
@@ -0,0 +1,344 @@
+#include "morphosis.h"
+
+/*
+** Triangle order for the post-transform vertex cache and for overdraw,
+** after Tipsify (Sander, Nehab and Barczak, 2007). Triangles are emitted
+** in fans around one vertex at a time; the next fan is around the vertex
+** of the last one that stays in the cache until its remaining triangles
+** are drawn, or else the latest dead end with triangles left. The cache
+** is the FIFO obj_acmr counts for VCACHE_SIZE: a vertex misses once
+** time - stamp >= VCACHE_SIZE, so it holds VCACHE_SIZE - 1 vertices.
+** The order is then cut where the cache starts over, at triangles with
+** three misses, and those clusters are drawn the most outward facing
+** first, so the front of the surface tends to come before what it hides.
+** All of it is linear, but for the sort of the clusters.
+**
+** The mesh is built slab after slab along z, so a chunk of consecutive
+** triangles is a compact piece of the surface: chunks are reordered on
+** their own, in parallel, and the order does not depend on the threads.
+*/
+
+static void					init_tipsify(t_tipsify *t)
+{
+	memset(t, 0, sizeof(*t));
+	if (!(t->adj = (uint *)malloc(3 * VCACHE_CHUNK * sizeof(uint)))
+		|| !(t->stack = (uint *)malloc(3 * VCACHE_CHUNK * sizeof(uint)))
+		|| !(t->tris = (uint *)malloc(3 * VCACHE_CHUNK * sizeof(uint)))
+		|| !(t->order = (uint *)malloc(VCACHE_CHUNK * sizeof(uint)))
+		|| !(t->done = (unsigned char *)malloc(VCACHE_CHUNK))
+		|| !(t->clusters = (t_cluster *)malloc(VCACHE_CHUNK * sizeof(t_cluster))))
+		error(MALLOC_FAIL_ERR, NULL);
+}
+
+static void					grow_tipsify(t_tipsify *t, size_t nv)
+{
+	if (nv <= t->cap_v)
+		return;
+	free(t->live);
+	free(t->stamp);
+	free(t->offs);
+	t->cap_v = nv;
+	if (!(t->live = (uint *)malloc(nv * sizeof(uint)))
+		|| !(t->stamp = (uint *)malloc(nv * sizeof(uint)))
+		|| !(t->offs = (uint *)malloc((nv + 1) * sizeof(uint))))
+		error(MALLOC_FAIL_ERR, NULL);
+}
+
+/*
+** Triangles around each vertex, adj[offs[v]] to adj[offs[v + 1]], and
+** live[v] their count. Vertices are numbered from lo, the lowest index of
+** the chunk.
+*/
+
+static void					adjacency(t_tipsify *t, const uint *idx, size_t nt, uint lo,
+								size_t nv)
+{
+	memset(t->live, 0, nv * sizeof(uint));
+	for (size_t i = 0; i < 3 * nt; i++)
+		t->live[idx[i] - lo]++;
+	t->offs[0] = 0;
+	for (size_t v = 0; v < nv; v++)
+	{
+		t->offs[v + 1] = t->offs[v] + t->live[v];
+		t->stamp[v] = t->offs[v];
+	}
+	for (size_t i = 0; i < 3 * nt; i++)
+		t->adj[t->stamp[idx[i] - lo]++] = (uint)(i / 3);
+}
+
+/*
+** Next fan: among the vertices of the last one, the oldest in the cache
+** that will still be there once its live triangles are drawn, or any live
+** one; then the latest dead end still live; then the next live vertex of
+** the chunk. nv when every triangle is drawn.
+*/
+
+static uint					next_fan(t_tipsify *t, size_t fan, size_t *top, uint *scan,
+								uint time, size_t nv)
+{
+	uint					best;
+	long					prio;
+	long					p;
+	uint					v;
+
+	best = (uint)nv;
+	prio = -1;
+	for (size_t i = fan; i < *top; i++)
+	{
+		v = t->stack[i];
+		if (!t->live[v])
+			continue;
+		p = (time - t->stamp[v] + 2 * t->live[v] < VCACHE_SIZE) ? time - t->stamp[v] : 0;
+		if (p > prio)
+		{
+			prio = p;
+			best = v;
+		}
+	}
+	if (best < nv)
+		return best;
+	while (*top)
+		if (t->live[v = t->stack[--*top]])
+			return v;
+	while (*scan < nv && !t->live[*scan])
+		(*scan)++;
+	return *scan;
+}
+
+static void					tipsify(t_tipsify *t, const uint *idx, size_t nt, uint lo, size_t nv)
+{
+	uint					time;
+	uint					scan;
+	uint					f;
+	size_t					top;
+	size_t					fan;
+	size_t					n;
+	uint					tri;
+	uint					v;
+
+	memset(t->done, 0, nt);
+	memset(t->stamp, 0, nv * sizeof(uint));
+	time = VCACHE_SIZE + 1;
+	scan = 0;
+	top = 0;
+	n = 0;
+	f = 0;
+	while (f < nv)
+	{
+		fan = top;
+		for (uint a = t->offs[f]; a < t->offs[f + 1]; a++)
+		{
+			if (t->done[tri = t->adj[a]])
+				continue;
+			t->done[tri] = 1;
+			t->order[n++] = tri;
+			for (int c = 0; c < 3; c++)
+			{
+				v = idx[3 * tri + c] - lo;
+				t->stack[top++] = v;
+				t->live[v]--;
+				if (time - t->stamp[v] >= VCACHE_SIZE)
+					t->stamp[v] = time++;
+			}
+		}
+		f = next_fan(t, fan, &top, &scan, time, nv);
+	}
+}
+
+/*
+** Cuts the order where a triangle misses the cache on all three vertices,
+** and returns the number of clusters.
+*/
+
+static size_t				cut_clusters(t_tipsify *t, const uint *idx, size_t nt, uint lo,
+								size_t nv)
+{
+	uint					time;
+	size_t					count;
+	int						miss;
+	uint					v;
+
+	memset(t->stamp, 0, nv * sizeof(uint));
+	time = VCACHE_SIZE + 1;
+	count = 0;
+	for (size_t i = 0; i < nt; i++)
+	{
+		miss = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			v = idx[3 * t->order[i] + c] - lo;
+			if (time - t->stamp[v] >= VCACHE_SIZE)
+			{
+				t->stamp[v] = time++;
+				miss++;
+			}
+		}
+		if (miss == 3 || !i)
+		{
+			t->clusters[count].first = i;
+			t->clusters[count++].count = 0;
+		}
+		t->clusters[count - 1].count++;
+	}
+	return count;
+}
+
+/*
+** How much cluster k faces away from the centre of the mesh: its centroid
+** seen from there, along its mean normal.
+*/
+
+static float				cluster_key(t_reorder *r, t_tipsify *t, const uint *idx, t_cluster *k)
+{
+	const float				*p[3];
+	double					c[3];
+	double					n[3];
+	double					e[2][3];
+	double					len;
+
+	memset(c, 0, sizeof(c));
+	memset(n, 0, sizeof(n));
+	for (size_t i = k->first; i < k->first + k->count; i++)
+	{
+		for (int j = 0; j < 3; j++)
+			p[j] = r->v + (size_t)idx[3 * t->order[i] + j] * r->stride;
+		for (int a = 0; a < 3; a++)
+		{
+			c[a] += p[0][a] + p[1][a] + p[2][a];
+			e[0][a] = p[1][a] - p[0][a];
+			e[1][a] = p[2][a] - p[0][a];
+		}
+		n[0] += e[0][1] * e[1][2] - e[0][2] * e[1][1];
+		n[1] += e[0][2] * e[1][0] - e[0][0] * e[1][2];
+		n[2] += e[0][0] * e[1][1] - e[0][1] * e[1][0];
+	}
+	len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+	if (len == 0.0)
+		return 0.0f;
+	for (int a = 0; a < 3; a++)
+		c[a] = c[a] / (3.0 * k->count) - r->centre[a];
+	return (float)((c[0] * n[0] + c[1] * n[1] + c[2] * n[2]) / len);
+}
+
+static int					outward_first(const void *a, const void *b)
+{
+	const t_cluster			*ka = (const t_cluster *)a;
+	const t_cluster			*kb = (const t_cluster *)b;
+
+	if (ka->key != kb->key)
+		return (ka->key > kb->key) ? -1 : 1;
+	return (ka->first > kb->first) - (ka->first < kb->first);
+}
+
+static void					reorder_chunk(t_reorder *r, t_tipsify *t, size_t chunk)
+{
+	uint					*idx;
+	size_t					nt;
+	size_t					nk;
+	uint					lo;
+	uint					hi;
+	uint					*dst;
+
+	idx = r->idx + 3 * chunk * VCACHE_CHUNK;
+	nt = r->num_tris - chunk * VCACHE_CHUNK;
+	nt = (nt < VCACHE_CHUNK) ? nt : VCACHE_CHUNK;
+	lo = idx[0];
+	hi = idx[0];
+	for (size_t i = 1; i < 3 * nt; i++)
+	{
+		lo = (idx[i] < lo) ? idx[i] : lo;
+		hi = (idx[i] > hi) ? idx[i] : hi;
+	}
+	grow_tipsify(t, (size_t)(hi - lo) + 1);
+	adjacency(t, idx, nt, lo, (size_t)(hi - lo) + 1);
+	tipsify(t, idx, nt, lo, (size_t)(hi - lo) + 1);
+	nk = cut_clusters(t, idx, nt, lo, (size_t)(hi - lo) + 1);
+	for (size_t k = 0; k < nk; k++)
+		t->clusters[k].key = cluster_key(r, t, idx, &t->clusters[k]);
+	qsort(t->clusters, nk, sizeof(t_cluster), outward_first);
+	memcpy(t->tris, idx, 3 * nt * sizeof(uint));
+	dst = idx;
+	for (size_t k = 0; k < nk; k++)
+		for (size_t i = t->clusters[k].first; i < t->clusters[k].first + t->clusters[k].count; i++)
+		{
+			memcpy(dst, t->tris + 3 * t->order[i], 3 * sizeof(uint));
+			dst += 3;
+		}
+}
+
+static void					*reorder_worker(void *arg)
+{
+	t_reorder				*r;
+	t_tipsify				t;
+	size_t					chunks;
+	size_t					chunk;
+
+	r = (t_reorder *)arg;
+	chunks = (r->num_tris + VCACHE_CHUNK - 1) / VCACHE_CHUNK;
+	init_tipsify(&t);
+	while ((chunk = __atomic_fetch_add(&r->next, 1, __ATOMIC_RELAXED)) < chunks)
+		reorder_chunk(r, &t, chunk);
+	clean_tipsify(&t);
+	return NULL;
+}
+
+/*
+** Reorders the num_tris triangles of idx in place. Vertex i of the num_v
+** is at v + i * stride, and only used to sort clusters.
+*/
+
+void						reorder_triangles(uint *idx, size_t num_tris, const float *v,
+								size_t stride, size_t num_v, uint threads)
+{
+	t_reorder				r;
+	double					sum[3];
+	pthread_t				*workers;
+	size_t					chunks;
+
+	if (!num_tris)
+		return;
+	memset(sum, 0, sizeof(sum));
+	for (size_t i = 0; i < num_v; i++)
+		for (int a = 0; a < 3; a++)
+			sum[a] += v[i * stride + a];
+	for (int a = 0; a < 3; a++)
+		r.centre[a] = num_v ? (float)(sum[a] / num_v) : 0.0f;
+	r.idx = idx;
+	r.num_tris = num_tris;
+	r.v = v;
+	r.stride = stride;
+	r.next = 0;
+	chunks = (num_tris + VCACHE_CHUNK - 1) / VCACHE_CHUNK;
+	threads = (threads < chunks) ? threads : (uint)chunks;
+	if (threads <= 1)
+	{
+		reorder_worker(&r);
+		return;
+	}
+	if (!(workers = (pthread_t *)malloc(threads * sizeof(pthread_t))))
+		error(MALLOC_FAIL_ERR, NULL);
+	for (uint t = 0; t < threads; t++)
+		if (pthread_create(&workers[t], NULL, reorder_worker, &r))
+			error(THREAD_ERR, NULL);
+	for (uint t = 0; t < threads; t++)
+		pthread_join(workers[t], NULL);
+	free(workers);
+}
+
+/*
+** Reorders the mesh in place and reports the average cache miss ratio
+** before and after, as obj_acmr counts it for a cache of VCACHE_SIZE.
+*/
+
+void						reorder_mesh(t_mesh *mesh, uint threads)
+{
+	float					acmr;
+
+	acmr = obj_acmr_index(mesh->idx, (int)mesh->num_idx, (int)mesh->num_v,
+		VCACHE_SIZE);
+	reorder_triangles(mesh->idx, mesh->num_idx / 3, (const float *)mesh->v,
+		sizeof(float3) / sizeof(float), mesh->num_v, threads);
+	mesh->ordered = 1;
+	printf("Vertex cache: ACMR %.3f -> %.3f\n", acmr, obj_acmr_index(mesh->idx,
+		(int)mesh->num_idx, (int)mesh->num_v, VCACHE_SIZE));
+}
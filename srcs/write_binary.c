@@ -0,0 +1,297 @@
+#include "morphosis.h"
+#include <strings.h>
+
+/*
+** Binary exports: the mesh buffers are packed into a WRITE_CHUNK buffer
+** and go to the file in a handful of large writes, so exporting is bound
+** by the disk rather than by number formatting. Every value is stored
+** little-endian, whatever the host.
+*/
+
+static void					open_writer(t_writer *w, const char *path)
+{
+	if (!(w->out = fopen(path, "wb")))
+		error(OPEN_FILE_ERR, NULL);
+	if (!(w->buf = (unsigned char *)malloc(WRITE_CHUNK)))
+		error(MALLOC_FAIL_ERR, NULL);
+	w->len = 0;
+}
+
+static void					flush_writer(t_writer *w)
+{
+	if (w->len && fwrite(w->buf, 1, w->len, w->out) != w->len)
+		error(WRITE_FILE_ERR, NULL);
+	w->len = 0;
+}
+
+static void					close_writer(t_writer *w)
+{
+	flush_writer(w);
+	free(w->buf);
+	if (fclose(w->out))
+		error(WRITE_FILE_ERR, NULL);
+}
+
+static void					put_bytes(t_writer *w, const void *src, size_t size)
+{
+	if (w->len + size > WRITE_CHUNK)
+		flush_writer(w);
+	if (size > WRITE_CHUNK)
+	{
+		if (fwrite(src, 1, size, w->out) != size)
+			error(WRITE_FILE_ERR, NULL);
+		return;
+	}
+	memcpy(w->buf + w->len, src, size);
+	w->len += size;
+}
+
+static void					put_u32(t_writer *w, uint32_t v)
+{
+	unsigned char			*p;
+
+	if (w->len + 4 > WRITE_CHUNK)
+		flush_writer(w);
+	p = w->buf + w->len;
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16);
+	p[3] = (unsigned char)(v >> 24);
+	w->len += 4;
+}
+
+static void					put_f32(t_writer *w, float f)
+{
+	uint32_t				u;
+
+	memcpy(&u, &f, sizeof(u));
+	put_u32(w, u);
+}
+
+static void					put_vertex(t_writer *w, float3 v)
+{
+	put_f32(w, v.x);
+	put_f32(w, v.y);
+	put_f32(w, v.z);
+}
+
+/*
+** Little-endian PLY: the vertices as float triples, then the faces as
+** lists of 3 uint indices.
+*/
+
+void						export_ply(t_mesh *mesh, const char *path)
+{
+	t_writer				w;
+	char					header[256];
+	const unsigned char		three = 3;
+	int						len;
+
+	open_writer(&w, path);
+	len = snprintf(header, sizeof(header), "ply\nformat binary_little_endian 1.0\n"
+		"element vertex %zu\nproperty float x\nproperty float y\nproperty float z\n"
+		"element face %zu\nproperty list uchar uint vertex_indices\nend_header\n",
+		mesh->num_v, mesh->num_idx / 3);
+	put_bytes(&w, header, (size_t)len);
+	for (size_t i = 0; i < mesh->num_v; i++)
+		put_vertex(&w, mesh->v[i]);
+	for (size_t i = 0; i < mesh->num_idx; i += 3)
+	{
+		put_bytes(&w, &three, 1);
+		put_u32(&w, mesh->idx[i]);
+		put_u32(&w, mesh->idx[i + 1]);
+		put_u32(&w, mesh->idx[i + 2]);
+	}
+	close_writer(&w);
+}
+
+/*
+** Binary STL carries no indices: every facet has its unit normal, its 3
+** corners and an empty attribute word.
+*/
+
+void						export_stl(t_mesh *mesh, const char *path)
+{
+	t_writer				w;
+	unsigned char			header[80];
+	float3					a;
+	float3					b;
+	float3					c;
+	float3					n;
+	float					len;
+
+	if (mesh->num_idx / 3 > UINT32_MAX)
+		error(WRITE_FILE_ERR, NULL);
+	open_writer(&w, path);
+	memset(header, 0, sizeof(header));
+	snprintf((char *)header, sizeof(header), "morphosis");
+	put_bytes(&w, header, sizeof(header));
+	put_u32(&w, (uint32_t)(mesh->num_idx / 3));
+	for (size_t i = 0; i < mesh->num_idx; i += 3)
+	{
+		a = mesh->v[mesh->idx[i]];
+		b = mesh->v[mesh->idx[i + 1]];
+		c = mesh->v[mesh->idx[i + 2]];
+		n.x = (b.y - a.y) * (c.z - a.z) - (b.z - a.z) * (c.y - a.y);
+		n.y = (b.z - a.z) * (c.x - a.x) - (b.x - a.x) * (c.z - a.z);
+		n.z = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+		len = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+		if (len > 0.0f)
+		{
+			n.x /= len;
+			n.y /= len;
+			n.z /= len;
+		}
+		put_vertex(&w, n);
+		put_vertex(&w, a);
+		put_vertex(&w, b);
+		put_vertex(&w, c);
+		put_bytes(&w, "\0\0", 2);
+	}
+	close_writer(&w);
+}
+
+/*
+** JSON chunk of the GLB: one node, one indexed triangle primitive, and the
+** positions then the indices in the binary chunk. POSITION needs its
+** bounds. An empty mesh leaves the scene empty.
+*/
+
+static size_t				glb_json(t_mesh *mesh, char *json, size_t size)
+{
+	float					lo[3];
+	float					hi[3];
+	float3					v;
+	int						len;
+
+	if (!mesh->num_idx)
+		return (size_t)snprintf(json, size, "{\"asset\":{\"version\":\"2.0\","
+			"\"generator\":\"morphosis\"},\"scene\":0,\"scenes\":[{\"nodes\":[]}]}");
+	v = mesh->v[0];
+	lo[0] = v.x;
+	lo[1] = v.y;
+	lo[2] = v.z;
+	memcpy(hi, lo, sizeof(hi));
+	for (size_t i = 1; i < mesh->num_v; i++)
+	{
+		v = mesh->v[i];
+		lo[0] = (v.x < lo[0]) ? v.x : lo[0];
+		lo[1] = (v.y < lo[1]) ? v.y : lo[1];
+		lo[2] = (v.z < lo[2]) ? v.z : lo[2];
+		hi[0] = (v.x > hi[0]) ? v.x : hi[0];
+		hi[1] = (v.y > hi[1]) ? v.y : hi[1];
+		hi[2] = (v.z > hi[2]) ? v.z : hi[2];
+	}
+	len = snprintf(json, size, "{\"asset\":{\"version\":\"2.0\",\"generator\":\"morphosis\"},"
+		"\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+		"\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0},\"indices\":1,\"mode\":4}]}],"
+		"\"buffers\":[{\"byteLength\":%zu}],"
+		"\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%zu,\"target\":34962},"
+		"{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"target\":34963}],"
+		"\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\","
+		"\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]},"
+		"{\"bufferView\":1,\"componentType\":5125,\"count\":%zu,\"type\":\"SCALAR\"}]}",
+		12 * mesh->num_v + 4 * mesh->num_idx, 12 * mesh->num_v, 12 * mesh->num_v,
+		4 * mesh->num_idx, mesh->num_v, lo[0], lo[1], lo[2], hi[0], hi[1], hi[2],
+		mesh->num_idx);
+	return (size_t)len;
+}
+
+/*
+** glTF binary: the header, the JSON chunk padded with spaces and the
+** binary chunk, each chunk a multiple of 4 bytes long.
+*/
+
+void						export_glb(t_mesh *mesh, const char *path)
+{
+	t_writer				w;
+	char					json[1024];
+	size_t					json_len;
+	size_t					bin_len;
+	size_t					total;
+
+	json_len = glb_json(mesh, json, sizeof(json));
+	while (json_len % 4)
+		json[json_len++] = ' ';
+	bin_len = mesh->num_idx ? 12 * mesh->num_v + 4 * mesh->num_idx : 0;
+	total = 12 + 8 + json_len + (bin_len ? 8 + bin_len : 0);
+	if (total > UINT32_MAX)
+		error(WRITE_FILE_ERR, NULL);
+	open_writer(&w, path);
+	put_bytes(&w, "glTF", 4);
+	put_u32(&w, 2);
+	put_u32(&w, (uint32_t)total);
+	put_u32(&w, (uint32_t)json_len);
+	put_bytes(&w, "JSON", 4);
+	put_bytes(&w, json, json_len);
+	if (bin_len)
+	{
+		put_u32(&w, (uint32_t)bin_len);
+		put_bytes(&w, "BIN", 4);
+		for (size_t i = 0; i < mesh->num_v; i++)
+			put_vertex(&w, mesh->v[i]);
+		for (size_t i = 0; i < mesh->num_idx; i++)
+			put_u32(&w, mesh->idx[i]);
+	}
+	close_writer(&w);
+}
+
+/*
+** FORMAT_* named by an extension or a --format value, or 0.
+*/
+
+int							format_of(const char *name)
+{
+	if (!strcasecmp(name, "obj"))
+		return FORMAT_OBJ;
+	if (!strcasecmp(name, "ply"))
+		return FORMAT_PLY;
+	if (!strcasecmp(name, "stl"))
+		return FORMAT_STL;
+	if (!strcasecmp(name, "glb"))
+		return FORMAT_GLB;
+	return 0;
+}
+
+/*
+** Triangles in vertex cache order for the binary formats, unless the
+** viewer or an earlier export already put them so. OBJ orders its own,
+** once welding has settled the vertices.
+*/
+
+static void					order_mesh(t_data *data)
+{
+	if (!data->mesh.ordered)
+		reorder_mesh(&data->mesh, data->opts.threads);
+}
+
+/*
+** Exports data->mesh to the output path, in the --format given or the
+** one of the path's extension. Anything else is written as OBJ.
+*/
+
+void						export_mesh(t_data *data)
+{
+	const char				*path;
+	const char				*dot;
+	int						format;
+
+	path = data->opts.output;
+	format = data->opts.format;
+	dot = strrchr(path, '.');
+	if (format == FORMAT_AUTO && dot && !strchr(dot, '/'))
+		format = format_of(dot + 1);
+	if (format == FORMAT_PLY || format == FORMAT_STL || format == FORMAT_GLB)
+		order_mesh(data);
+	if (format == FORMAT_PLY)
+		export_ply(&data->mesh, path);
+	else if (format == FORMAT_STL)
+		export_stl(&data->mesh, path);
+	else if (format == FORMAT_GLB)
+		export_glb(&data->mesh, path);
+	else
+		export_obj(data);
+	if (format == FORMAT_PLY || format == FORMAT_STL || format == FORMAT_GLB)
+		printf("Exported %zu vertices, %zu triangles to %s\n",
+			data->mesh.num_v, data->mesh.num_idx / 3, path);
+}
@@ -1,54 +1,99 @@
 #include "morphosis.h"
+#include <limits.h>
 
-static void						fetch_vertex_coords(float3 vertex, float *res)
+/*
+** Orders the triangles of the surface for the vertex cache, see
+** reorder_triangles, once welding has settled the vertex indices.
+*/
+
+static void					reorder_obj(obj *o, int surface, uint threads)
 {
-	res[0] = vertex.x;
-	res[1] = vertex.y;
-	res[2] = vertex.z;
+	uint					*idx;
+	float					*v;
+	size_t					nt;
+	size_t					nv;
+	float					acmr;
+
+	nt = (size_t)obj_num_poly(o, surface);
+	nv = (size_t)obj_num_vert(o);
+	if (!(idx = (uint *)malloc(3 * nt * sizeof(uint) + 1))
+		|| !(v = (float *)malloc(3 * nv * sizeof(float) + 1)))
+		error(MALLOC_FAIL_ERR, NULL);
+	acmr = obj_acmr(o, VCACHE_SIZE);
+	obj_get_polys(o, surface, idx);
+	obj_get_verts(o, v, 3);
+	reorder_triangles(idx, nt, v, 3, nv, threads);
+	obj_set_polys(o, surface, idx);
+	printf("Vertex cache: ACMR %.3f -> %.3f\n", acmr, obj_acmr(o, VCACHE_SIZE));
+	free(idx);
+	free(v);
 }
 
 void 						export_obj(t_data *data)
 {
 	obj 					*o;
 	int						surface;
+	int						vc;
 
 	o = obj_create(NULL);
 	surface = obj_add_surf(o);
 	write_mesh(data, surface, o);
+	if (data->opts.weld > 0.0f)
+	{
+		vc = obj_num_vert(o);
+		obj_uniq(o, data->opts.weld, -1.0f, 0, (int)data->opts.threads);
+		printf("Welded %d vertices into %d\n", vc, obj_num_vert(o));
+	}
+	reorder_obj(o, surface, data->opts.threads);
 	printf("SAVING-----\n");
-	obj_sort(o, 32);
 	obj_proc(o);
-	obj_write(o, OUTPUT_FILE, NULL, OUTPUT_PRECISION);
+	if (!obj_write(o, data->opts.output, NULL, OUTPUT_PRECISION, (int)data->opts.threads))
+		error(WRITE_FILE_ERR, data);
 	obj_delete(o);
 }
 
+/*
+** Vertices go in once, then every triangle refers to them by index, so
+** the file carries each shared vertex a single time. Both are copied in
+** one step each, straight from the mesh buffers.
+*/
+
 void						write_mesh(t_data *data, int surface, obj *o)
 {
-	float3 					**tris;
-	uint 					i;
-	int						polygon;
-	int 					verts[3];
-	float 					*vertex;
+	t_mesh 					*mesh;
+	int						base;
 
-	if (!(vertex = (float *)malloc(3 * sizeof(float))))
+	mesh = &data->mesh;
+	if (mesh->num_v > INT_MAX || mesh->num_idx / 3 > INT_MAX)
+		error(MALLOC_FAIL_ERR, data);
+	base = obj_add_verts(o, (int)mesh->num_v, (const float *)mesh->v,
+		(int)(sizeof(float3) / sizeof(float)));
+	if (base < 0 || obj_add_polys(o, surface, (int)(mesh->num_idx / 3), mesh->idx, base) < 0)
 		error(MALLOC_FAIL_ERR, data);
-	tris = data->triangles;
-	i = 0;
-	while (i < data->gl->num_tris)
+}
+
+/*
+** Streaming export: a committed slab writes the vertices it adds, those
+** remapped to base or above, then its faces. Every face only refers to
+** vertices already in the file, so the mesh never has to be held whole.
+*/
+
+void						stream_slab(FILE *out, t_mesh *slab, uint *remap, size_t base)
+{
+	float3					*v;
+	uint					*idx;
+
+	for (size_t i = 0; i < slab->num_v; i++)
+	{
+		if (remap[i] < base)
+			continue;
+		v = &slab->v[i];
+		fprintf(out, "v %.*f %.*f %.*f\n", OUTPUT_PRECISION, v->x,
+			OUTPUT_PRECISION, v->y, OUTPUT_PRECISION, v->z);
+	}
+	for (size_t i = 0; i < slab->num_idx; i += 3)
 	{
-		// Show progress every 1000 triangles instead of every triangle
-		if (i % 1000 == 0 || i == data->gl->num_tris - 1)
-			printf("Written: %.3f %%\n", (((float)i / data->gl->num_tris) * 100));
-		
-		polygon = obj_add_poly(o, surface);
-		for (int v = 0; v < 3; v++)
-		{
-			verts[v] = obj_add_vert(o);
-			fetch_vertex_coords(tris[i][v], vertex);
-			obj_set_vert_v(o, verts[v], vertex);
-		}
-		obj_set_poly(o, surface, polygon, verts);
-		i++;
+		idx = &slab->idx[i];
+		fprintf(out, "f %u %u %u\n", remap[idx[0]] + 1, remap[idx[1]] + 1, remap[idx[2]] + 1);
 	}
-	free(vertex);
 }
@@ -0,0 +1,83 @@
+#include <lib_complex.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+** Julia orbits of a slice of points, stepped with cl_quat_mult and
+** cl_quat_sum and then with the fused cl_quat_sqr_add. Both escape on
+** the same iterations, and the points are checked to agree.
+*/
+
+#define BENCH_SIDE 256
+#define BENCH_ITER 64
+
+static double				now(void)
+{
+	struct timespec			t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static cl_quat				point(int i, int j)
+{
+	cl_quat					q;
+
+	q.x = -1.5f + 3.0f * i / BENCH_SIDE;
+	q.y = -1.5f + 3.0f * j / BENCH_SIDE;
+	q.z = 0.0f;
+	q.w = 0.0f;
+	return q;
+}
+
+static long					run(cl_quat c, int fused, double *seconds)
+{
+	cl_quat					z;
+	TYPE					mod;
+	long					total;
+	double					start;
+	int						n;
+
+	total = 0;
+	start = now();
+	for (int i = 0; i < BENCH_SIDE; i++)
+		for (int j = 0; j < BENCH_SIDE; j++)
+		{
+			z = point(i, j);
+			n = 0;
+			do
+			{
+				if (fused)
+					z = cl_quat_sqr_add(z, c, &mod);
+				else
+				{
+					z = cl_quat_sum(cl_quat_mult(z, z), c);
+					mod = cl_quat_mod_squared(z);
+				}
+			} while (++n < BENCH_ITER && mod <= 4);
+			total += n;
+		}
+	*seconds = now() - start;
+	return total;
+}
+
+int							main(void)
+{
+	cl_quat					c;
+	double					general;
+	double					fused;
+	long					steps;
+
+	c.x = -0.2f;
+	c.y = 0.8f;
+	c.z = 0.0f;
+	c.w = 0.0f;
+	run(c, 0, &general);
+	steps = run(c, 0, &general);
+	if (run(c, 1, &fused) != steps)
+		printf("warning: the two steps escape differently\n");
+	printf("cl_quat_mult + cl_quat_sum: %.2f ns/step\n", 1e9 * general / steps);
+	printf("cl_quat_sqr_add:            %.2f ns/step\n", 1e9 * fused / steps);
+	printf("speedup: %.2fx over %ld steps\n", general / fused, steps);
+	return 0;
+}
@@ -0,0 +1,122 @@
+#include <lib_complex.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+** cl_quat_sqr and cl_quat_sqr_add against the general product and sum,
+** and cl_quat_mult against the Hamilton product of distinct quaternions.
+** Products are compared within a few roundings of the largest term, as
+** the two sides round in a different order.
+*/
+
+static int					g_failed;
+
+static cl_quat				quat(TYPE x, TYPE y, TYPE z, TYPE w)
+{
+	cl_quat					q;
+
+	q.x = x;
+	q.y = y;
+	q.z = z;
+	q.w = w;
+	return q;
+}
+
+static TYPE					random_component(TYPE scale)
+{
+	return scale * (2 * (TYPE)rand() / (TYPE)RAND_MAX - 1);
+}
+
+static int					close_to(cl_quat a, cl_quat b, TYPE scale)
+{
+	const TYPE				tol = 8 * 1.2e-7f * scale;
+
+	return (fabs(a.x - b.x) <= tol && fabs(a.y - b.y) <= tol
+		&& fabs(a.z - b.z) <= tol && fabs(a.w - b.w) <= tol);
+}
+
+static void					check(int ok, const char *what, cl_quat q)
+{
+	if (ok)
+		return;
+	g_failed++;
+	printf("FAIL %s at (%g, %g, %g, %g)\n", what, q.x, q.y, q.z, q.w);
+}
+
+static void					check_step(cl_quat q, cl_quat c)
+{
+	cl_quat					sqr;
+	cl_quat					step;
+	TYPE					mod;
+	TYPE					scale;
+
+	scale = cl_quat_mod_squared(q) + fabs(c.x) + fabs(c.y) + fabs(c.z) + fabs(c.w);
+	sqr = cl_quat_sqr(q);
+	check(close_to(sqr, cl_quat_mult(q, q), scale), "cl_quat_sqr", q);
+	step = cl_quat_sqr_add(q, c, &mod);
+	check(close_to(step, cl_quat_sum(cl_quat_mult(q, q), c), scale), "cl_quat_sqr_add", q);
+	check(cl_quat_equal(step, cl_quat_sum(sqr, c)), "cl_quat_sqr_add != sqr + c", q);
+	check(mod == cl_quat_mod_squared(step), "cl_quat_sqr_add |z|^2", q);
+}
+
+static void					check_edges(void)
+{
+	const TYPE				big = 1e18f;
+	const cl_quat			c = quat(-0.2f, 0.8f, 0.0f, 0.1f);
+	cl_quat					zero;
+	TYPE					mod;
+
+	zero = quat(0, 0, 0, 0);
+	check(cl_quat_equal(cl_quat_sqr(zero), zero), "0^2", zero);
+	check(cl_quat_equal(cl_quat_sqr_add(zero, c, &mod), c), "0^2 + c", zero);
+	check(mod == cl_quat_mod_squared(c), "|0^2 + c|^2", zero);
+	for (int s = -1; s <= 1; s += 2)
+	{
+		check(cl_quat_equal(cl_quat_sqr(quat(0, 0, 0, s)), quat(-1, 0, 0, 0)), "(+-k)^2", quat(0, 0, 0, s));
+		check(cl_quat_equal(cl_quat_sqr(quat(s, 0, 0, 0)), quat(1, 0, 0, 0)), "(+-1)^2", quat(s, 0, 0, 0));
+		check_step(quat(0, 0, 0, s * 1.5f), c);
+		check_step(quat(s * 0.5f, 0, 0, s * 1.5f), c);
+	}
+	check_step(quat(big, -big, big, -big), c);
+	check_step(quat(big, 1, -1, 0), c);
+	check_step(quat(0, big, 0, -big), zero);
+}
+
+/*
+** The w term once read q1.x * q1.w, which only squaring hides: the
+** product of distinct quaternions and of the units i, j, k shows it.
+*/
+
+static void					check_mult(void)
+{
+	const cl_quat			i = quat(0, 1, 0, 0);
+	const cl_quat			j = quat(0, 0, 1, 0);
+	const cl_quat			k = quat(0, 0, 0, 1);
+	cl_quat					p;
+
+	p = cl_quat_mult(quat(1, 2, 3, 4), quat(5, 6, 7, 8));
+	check(cl_quat_equal(p, quat(-60, 12, 30, 24)), "(1,2,3,4)(5,6,7,8)", p);
+	p = cl_quat_mult(quat(5, 6, 7, 8), quat(1, 2, 3, 4));
+	check(cl_quat_equal(p, quat(-60, 20, 14, 32)), "(5,6,7,8)(1,2,3,4)", p);
+	check(cl_quat_equal(cl_quat_mult(i, j), k), "ij = k", i);
+	check(cl_quat_equal(cl_quat_mult(j, k), i), "jk = i", j);
+	check(cl_quat_equal(cl_quat_mult(k, i), j), "ki = j", k);
+	check(cl_quat_equal(cl_quat_mult(quat(2, 0, 0, 0), k), quat(0, 0, 0, 2)), "2k", k);
+}
+
+int							main(void)
+{
+	const TYPE				scales[3] = {1.0f, 1e-3f, 1e6f};
+
+	srand(42);
+	check_edges();
+	check_mult();
+	for (int s = 0; s < 3; s++)
+		for (int n = 0; n < 100000; n++)
+			check_step(quat(random_component(scales[s]), random_component(scales[s]),
+				random_component(scales[s]), random_component(scales[s])),
+				quat(random_component(1), random_component(1),
+				random_component(1), random_component(1)));
+	printf("%s: %d failed\n", g_failed ? "FAIL" : "OK", g_failed);
+	return g_failed != 0;
+}